@@ -0,0 +1,70 @@
+/*
+ * Lock-free single-producer/single-consumer ring of stereo float frames
+ *
+ * The emu thread writes and v2_render_block reads, so the host's realtime
+ * audio thread never waits on a lock. Positions count frames since Reset
+ * and only wrap as uint32_t; each side publishes its own with a release
+ * store and reads the other's with an acquire load. The two positions are
+ * kept on separate cache lines (padding rather than alignas, because the
+ * plugin instance comes from calloc).
+ */
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+struct AudioRing {
+  static const int FRAMES = 1024; // power of two, the largest latency profile
+  static const int CACHE_LINE = 64;
+
+  std::atomic<uint32_t> write_pos; // producer
+  char pad0[CACHE_LINE - sizeof(std::atomic<uint32_t>)];
+  std::atomic<uint32_t> read_pos; // consumer
+  char pad1[CACHE_LINE - sizeof(std::atomic<uint32_t>)];
+  float data[FRAMES * 2]; // interleaved L/R
+
+  // Only while neither side is running
+  void Reset() {
+    write_pos.store(0, std::memory_order_relaxed);
+    read_pos.store(0, std::memory_order_relaxed);
+  }
+
+  // Frames readable; exact for the consumer, a lower bound for others
+  int Available() const {
+    return (int)(write_pos.load(std::memory_order_acquire) -
+                 read_pos.load(std::memory_order_acquire));
+  }
+
+  // Frames writable; exact for the producer, a lower bound for others
+  int Free() const { return FRAMES - Available(); }
+
+  // Producer: copies up to n frames in, returns the number written
+  int Write(const float *frames, int n) {
+    uint32_t w = write_pos.load(std::memory_order_relaxed);
+    uint32_t r = read_pos.load(std::memory_order_acquire);
+    int space = FRAMES - (int)(w - r);
+    if (n > space)
+      n = space;
+    int at = (int)(w & (FRAMES - 1));
+    int first = n < FRAMES - at ? n : FRAMES - at;
+    memcpy(&data[at * 2], frames, first * 2 * sizeof(float));
+    memcpy(&data[0], frames + first * 2, (n - first) * 2 * sizeof(float));
+    write_pos.store(w + n, std::memory_order_release);
+    return n;
+  }
+
+  // Consumer: copies up to n frames out, returns the number read
+  int Read(float *frames, int n) {
+    uint32_t r = read_pos.load(std::memory_order_relaxed);
+    uint32_t w = write_pos.load(std::memory_order_acquire);
+    int avail = (int)(w - r);
+    if (n > avail)
+      n = avail;
+    int at = (int)(r & (FRAMES - 1));
+    int first = n < FRAMES - at ? n : FRAMES - at;
+    memcpy(frames, &data[at * 2], first * 2 * sizeof(float));
+    memcpy(frames + first * 2, &data[0], (n - first) * 2 * sizeof(float));
+    read_pos.store(r + n, std::memory_order_release);
+    return n;
+  }
+};
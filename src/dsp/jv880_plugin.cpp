@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include <pthread.h>
+#include <semaphore.h>
 #include <unistd.h>
 #include <pwd.h>
 #include <time.h>
@@ -18,9 +19,8 @@
 #include <math.h>
 
 #include "mcu.h"
-extern "C" {
-#include "resample/libresample.h"
-}
+#include "polyphase.h"
+#include "audio_ring.h"
 
 extern "C" {
 #include "plugin_api_v1.h"
@@ -38,7 +38,6 @@ static void jv_debug(const char *fmt, ...) {
 #define PATCH_OFFSET_PRESET_A   0x010ce0  /* Preset A (A.Piano 1, etc.) */
 #define PATCH_OFFSET_PRESET_B   0x018ce0  /* Preset B (Pizzicato, etc.) */
 #define NVRAM_PATCH_OFFSET      0x0d70    /* Working patch area (362 bytes) */
-#define NVRAM_MODE_OFFSET       0x11
 #define NVRAM_PATCH_INTERNAL    0x1000    /* User patch storage: 64 × 362 = 23168 bytes (up to 0x6A80) */
 #define NUM_USER_PATCHES        64
 
@@ -151,27 +150,80 @@ typedef struct {
     uint32_t bank_count;
 } CacheHeader;
 
+/* Warm-boot image: machine state right after the startup warmup */
+#define WARMBOOT_MAGIC 0x4A565742  /* "JVWB" */
+#define WARMBOOT_VERSION 1
+#define WARMBOOT_FILENAME "warmboot.bin"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t state_size;    /* sizeof(mcu_state_t), catches layout changes */
+    uint32_t rom_crc[4];    /* rom1, rom2, waverom1, waverom2 */
+    uint32_t nvram_crc;     /* NVRAM and cardram as they were before warmup */
+    uint32_t cardram_crc;
+} WarmbootHeader;
+
 /* Expansion file list for fingerprinting */
 #define MAX_EXP_FILES 64
 
 /* Parameter mapping constants */
 #define MAP_SRAM_SCAN_SIZE 512  /* Bytes to scan around temp perf */
 
-/* Audio ring buffer size */
-#define AUDIO_RING_SIZE 512
-
 /* MIDI queue sizes */
 #define MIDI_QUEUE_SIZE 256
 #define MIDI_MSG_MAX_LEN 256
 
 /* Sample rates */
-/* JV-880 PCM runs at 64 kHz with oversampling enabled. */
+/* JV-880 PCM runs at 64 kHz with oversampling enabled, 32 kHz without
+ * (see the "output_mode" param). */
 #define JV880_SAMPLE_RATE 64000
 #define MOVE_SAMPLE_RATE 44100
 
 
-/* Output gain (reduce to prevent clipping) */
-#define OUTPUT_GAIN_SHIFT 1  /* -6dB headroom to prevent clipping on hot patches */
+/* Emu thread pacing: it renders while the ring is at least refill_free
+ * frames below the latency profile's target, then sleeps on emu_wake until
+ * v2_render_block drains it that far again, or EMU_WAIT_TIMEOUT_US passes
+ * (so requests queued while the host isn't rendering are still picked
+ * up). */
+#define EMU_WAIT_TIMEOUT_US 10000
+
+/* Latency profiles, selected with the "latency" param. The ring target is
+ * counted in host blocks of HOST_BLOCK_FRAMES; chunk is the samples per
+ * updateSC55 call and refill the free frames that wake the emu thread. */
+#define HOST_BLOCK_FRAMES 128
+#define LATENCY_DEFAULT 1
+
+typedef struct {
+    const char *name;
+    int blocks;
+    int chunk;
+    int refill;
+} v2_latency_profile_t;
+
+static const v2_latency_profile_t v2_latency_profiles[] = {
+    {"tight", 2, 32, 32},
+    {"normal", 4, 64, 64},
+    {"safe", 8, 128, 128},
+};
+#define LATENCY_PROFILE_COUNT (int)(sizeof(v2_latency_profiles) / sizeof(v2_latency_profiles[0]))
+
+/* Voice governor: the emu thread's smoothed load (time spent per block
+ * over the block's audio duration) is checked every GOV_INTERVAL_BLOCKS
+ * (~32 ms). Over GOV_LOAD_HIGH, or after an underrun, the PCM voice limit
+ * drops two below the voices in use; under GOV_LOAD_LOW it rises by one
+ * and switches off again at full polyphony. With GOV_MIN_VOICES or fewer
+ * in use the voices aren't the cause, so nothing is stolen. Underruns
+ * from a reset warmup or a snapshot restore, which leave the ring empty,
+ * don't count. */
+#define GOV_INTERVAL_BLOCKS 64
+#define GOV_LOAD_HIGH 0.85f
+#define GOV_LOAD_LOW 0.60f
+#define GOV_MIN_VOICES 8
+
+/* Output gain (reduce to prevent clipping), applied with the dither when
+ * the float ring is converted to int16 in v2_render_block */
+#define OUTPUT_GAIN 0.5f  /* -6dB headroom to prevent clipping on hot patches */
 
 /* ========================================================================
  * TONE PARAMETER LOOKUP TABLE
@@ -414,6 +466,28 @@ typedef struct {
     int pending_perf_select;   /* Countdown to select performance after mode switch */
     int pending_patch_select;  /* Countdown to select patch after mode switch */
     volatile int warmup_remaining;  /* Warmup cycles remaining after reset */
+    volatile int reset_request;     /* Warmup cycles after an emu thread SC55_Reset, -1 = none */
+
+    /* Post-warmup machine snapshots per mode (0=patch, 1=performance) */
+    mcu_state_t *mode_snapshot[2];
+    int mode_snapshot_expansion[2];     /* current_expansion when captured */
+    volatile int snapshot_capture_mode; /* Capture when warmup ends, -1 = none */
+    volatile int pending_restore_mode;  /* Snapshot for emu thread to load, -1 = none */
+    volatile int output_mode_request;   /* PCM_OUTPUT_* for emu thread, -1 = none */
+    int output_mode;                    /* PCM_OUTPUT_* in use */
+    volatile int latency_request;       /* v2_latency_profiles index for emu thread, -1 = none */
+    int latency_profile;                /* v2_latency_profiles index in use */
+    volatile int ring_target;           /* Ring fill the emu thread keeps, in frames */
+    volatile int refill_free;           /* Frames below ring_target that wake the emu thread */
+    int emu_chunk;                      /* Samples per updateSC55 in the emu thread */
+
+    /* Voice governor (opt-in), run by the emu thread */
+    volatile int voice_governor;        /* steal voices under sustained overload */
+    float emu_load;                     /* emu thread time / audio time, smoothed */
+    int governor_blocks;                /* blocks since the last decision */
+    int governor_underruns;             /* underrun_count at the last decision */
+    int governor_rebase;                /* ignore underruns until the ring is refilled */
+    uint32_t rom_crc[4];                /* rom1, rom2, waverom1, waverom2 */
     int deferred_patch_index;      /* Patch index waiting for debounce to complete */
     int deferred_patch_countdown;  /* Render blocks remaining before executing deferred patch */
 
@@ -424,13 +498,9 @@ typedef struct {
     int save_slot_index;
     int load_slot_index;
 
-    /* Resampling state (libresample) */
-    void *resampleL;
-    void *resampleR;
-    float resample_in_l[4096];  /* Input buffer for resampler */
-    float resample_in_r[4096];
-    float resample_out_l[4096]; /* Output buffer for resampler */
-    float resample_out_r[4096];
+    /* Resampling state: stereo polyphase, fed from mcu->sample_buffer */
+    PolyphaseResampler resampler;
+    float resample_out[4096 * 2]; /* Interleaved resampler output */
 
     /* Loading state */
     char loading_status[256];
@@ -462,17 +532,20 @@ typedef struct {
     pthread_t load_thread;
     volatile int load_thread_running;
 
-    /* Audio ring buffer */
-    int16_t audio_ring[AUDIO_RING_SIZE * 2];
-    volatile int ring_write;
-    volatile int ring_read;
-    pthread_mutex_t ring_mutex;
+    /* Audio ring buffer: resampler output, full scale 1.0. Lock-free,
+     * the emu thread writes and v2_render_block reads */
+    AudioRing ring;
+    uint32_t dither_seed;  /* LCG state for v2_output_sample */
+    sem_t emu_wake;                 /* Posted by render_block, see v2_emu_wait */
+    std::atomic<int> emu_sleeping;  /* Emu thread is (about to be) in v2_emu_wait */
 
-    /* MIDI queue */
+    /* MIDI queue; midi_mutex serialises the non-realtime producers
+     * (patch/mode selection, state restore), the audio ring never takes it */
     uint8_t midi_queue[MIDI_QUEUE_SIZE][MIDI_MSG_MAX_LEN];
     int midi_queue_len[MIDI_QUEUE_SIZE];
     volatile int midi_write;
     volatile int midi_read;
+    pthread_mutex_t midi_mutex;
 
     /* Other settings */
     int octave_transpose;
@@ -514,9 +587,47 @@ static void v2_load_expansion_to_emulator(jv880_instance_t *inst, int exp_index)
 static void v2_select_patch(jv880_instance_t *inst, int global_index);
 static void v2_select_performance(jv880_instance_t *inst, int perf_index);
 static void v2_set_mode(jv880_instance_t *inst, int performance_mode);
+static void v2_capture_mode_snapshot(jv880_instance_t *inst, int mode);
+static void v2_restore_mode_snapshot(jv880_instance_t *inst, int mode);
 static void v2_send_all_notes_off(jv880_instance_t *inst);
 static void v2_set_param(void *instance, const char *key, const char *val);
 
+static const char *const v2_output_mode_names[] = {"oversampled", "native", "single"};
+
+/* Ring target, refill watermark and chunk size of a latency profile. The
+ * ring storage is sized for the largest profile; lowering the target just
+ * lets the consumer drain the surplus. */
+static void v2_set_latency_profile(jv880_instance_t *inst, int profile) {
+    const v2_latency_profile_t *p = &v2_latency_profiles[profile];
+    inst->latency_profile = profile;
+    inst->ring_target = p->blocks * HOST_BLOCK_FRAMES;
+    inst->refill_free = p->refill;
+    inst->emu_chunk = p->chunk;
+}
+
+/* Core output rate of the samples last returned by updateSC55 */
+static int v2_core_rate(jv880_instance_t *inst) {
+    return JV880_SAMPLE_RATE / 4 * inst->mcu->output_frame_samples;
+}
+
+/* Nominal MIDI-to-audio latency in ms: MIDI is applied at the start of an
+ * emu chunk, so on average half a chunk (emu_chunk counts interleaved
+ * samples) goes by before it sounds. Then it waits behind the ring's
+ * average fill (it is refilled between ring_target - refill_free and
+ * ring_target), the resampler's group delay and the host block being
+ * played. */
+static double v2_latency_ms(jv880_instance_t *inst) {
+    double core_frames = inst->emu_chunk / 4 + inst->resampler.taps / 2;
+    double out_frames = inst->ring_target - inst->refill_free / 2 + HOST_BLOCK_FRAMES;
+    return 1000.0 * (core_frames / v2_core_rate(inst) + out_frames / MOVE_SAMPLE_RATE);
+}
+
+/* Resample the last updateSC55 output into inst->resample_out */
+static int v2_resample(jv880_instance_t *inst, int in_samples) {
+    return inst->resampler.Process(inst->mcu->sample_buffer, in_samples, v2_core_rate(inst),
+                                   inst->resample_out, 4096);
+}
+
 /* v2: Get file size helper */
 static uint32_t v2_get_file_size(const char *path) {
     FILE *f = fopen(path, "rb");
@@ -823,9 +934,13 @@ static void v2_load_expansion_to_emulator(jv880_instance_t *inst, int exp_index)
 
     v2_send_all_notes_off(inst);
 
-    /* Load waveform data to expansion waverom */
-    memset(inst->mcu->pcm.waverom_exp, 0, EXPANSION_SIZE_8MB);
-    memcpy(inst->mcu->pcm.waverom_exp, exp->unscrambled, exp->rom_size);
+    /* Map expansion waveforms into wave banks 3-6 in place (the unscrambled
+     * data lives until destroy); banks past a 2MB board read as silence */
+    for (int b = 0; b < 4; b++) {
+        uint32_t offset = b * Pcm::WAVE_BANK_SIZE;
+        inst->mcu->pcm.PCM_MapWaveBank(3 + b,
+            offset < exp->rom_size ? exp->unscrambled + offset : nullptr);
+    }
 
     /* Load patch definitions to cardram for Card patches (64-127 in Performance mode)
      * The JV-880 looks for Card patch data in cardram when a part uses patchnumber 64-127.
@@ -872,8 +987,9 @@ static void v2_load_expansion_to_emulator(jv880_instance_t *inst, int exp_index)
      * Performance mode skips reset since Card patches handle it differently.
      * Warmup kept short (5000 cycles) - debounce prevents repeated resets. */
     if (!inst->performance_mode) {
-        inst->mcu->SC55_Reset();
-        inst->warmup_remaining = 1000;
+        inst->snapshot_capture_mode = -1;  /* Short warmup, not worth keeping */
+        inst->pending_restore_mode = -1;
+        inst->reset_request = 1000;
         fprintf(stderr, "JV880 v2: Loaded expansion %s to emulator (with reset, short warmup)\n", exp->name);
     } else {
         fprintf(stderr, "JV880 v2: Loaded expansion %s for Card patches (no reset)\n", exp->name);
@@ -928,7 +1044,7 @@ static void v2_select_patch(jv880_instance_t *inst, int global_index) {
 
     /* Send PC 0 to trigger emulator to reload from NVRAM */
     uint8_t pc_msg[2] = { 0xC0, 0x00 };
-    pthread_mutex_lock(&inst->ring_mutex);
+    pthread_mutex_lock(&inst->midi_mutex);
     int next = (inst->midi_write + 1) % MIDI_QUEUE_SIZE;
     if (next != inst->midi_read) {
         memcpy(inst->midi_queue[inst->midi_write], pc_msg, 2);
@@ -938,7 +1054,7 @@ static void v2_select_patch(jv880_instance_t *inst, int global_index) {
     } else {
         jv_debug("[v2_select_patch] ERROR: MIDI queue full!\n");
     }
-    pthread_mutex_unlock(&inst->ring_mutex);
+    pthread_mutex_unlock(&inst->midi_mutex);
 
     /* Reset macro offsets on patch change */
     inst->macro_cutoff = 0;
@@ -1084,6 +1200,98 @@ static int v2_load_cache(jv880_instance_t *inst) {
     return 1;
 }
 
+/* CRC-32 (IEEE), used to key the warm-boot image to the loaded ROMs */
+struct Crc32Table {
+    uint32_t entry[256];
+    Crc32Table() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            entry[i] = c;
+        }
+    }
+};
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len) {
+    /* Every instance's load thread gets here; a function-local static is
+     * built exactly once, and the others wait for it */
+    static const Crc32Table table;
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+        crc = table.entry[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+/* v2: Fill in the warm-boot key for the machine as it is now */
+static void v2_warmboot_header(jv880_instance_t *inst, WarmbootHeader *hdr) {
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = WARMBOOT_MAGIC;
+    hdr->version = WARMBOOT_VERSION;
+    hdr->state_size = sizeof(mcu_state_t);
+    memcpy(hdr->rom_crc, inst->rom_crc, sizeof(hdr->rom_crc));
+    hdr->nvram_crc = crc32_update(0, inst->mcu->nvram, NVRAM_SIZE);
+    hdr->cardram_crc = crc32_update(0, inst->mcu->cardram, CARDRAM_SIZE);
+}
+
+/* v2: Save warm-boot image. Called right after the startup warmup, with
+ * the header computed before it ran. */
+static void v2_save_warmboot(jv880_instance_t *inst, const WarmbootHeader *hdr) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/roms/%s", inst->module_dir, WARMBOOT_FILENAME);
+
+    mcu_state_t *state = (mcu_state_t*)malloc(sizeof(mcu_state_t));
+    if (!state) return;
+    inst->mcu->MCU_SaveState(state);
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "JV880 v2: Failed to save warm-boot image to %s: %s\n", path, strerror(errno));
+        free(state);
+        return;
+    }
+    int ok = fwrite(hdr, sizeof(*hdr), 1, f) == 1 &&
+             fwrite(state, sizeof(mcu_state_t), 1, f) == 1;
+    fclose(f);
+    free(state);
+
+    if (!ok) {
+        unlink(path);
+        return;
+    }
+    chown_to_ableton(path);
+    fprintf(stderr, "JV880 v2: Saved warm-boot image\n");
+}
+
+/* v2: Restore the machine from the warm-boot image if it was made from the
+ * same ROMs and starting NVRAM. Only safe before the emu thread starts. */
+static int v2_load_warmboot(jv880_instance_t *inst, const WarmbootHeader *expect) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/roms/%s", inst->module_dir, WARMBOOT_FILENAME);
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+
+    WarmbootHeader hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+        memcmp(&hdr, expect, sizeof(hdr)) != 0) {
+        fclose(f);
+        return 0;
+    }
+
+    mcu_state_t *state = (mcu_state_t*)malloc(sizeof(mcu_state_t));
+    if (!state) { fclose(f); return 0; }
+    int ok = fread(state, sizeof(mcu_state_t), 1, f) == 1;
+    fclose(f);
+
+    if (ok) {
+        inst->mcu->MCU_LoadState(state);
+        fprintf(stderr, "JV880 v2: Restored warm-boot image\n");
+    }
+    free(state);
+    return ok;
+}
+
 /* v2: Load thread function */
 static void* v2_load_thread_func(void *arg) {
     jv880_instance_t *inst = (jv880_instance_t*)arg;
@@ -1111,59 +1319,45 @@ static void* v2_load_thread_func(void *arg) {
         v2_select_patch(inst, 0);
     }
 
-    /* Warmup */
-    fprintf(stderr, "JV880 v2: Running warmup...\n");
-    snprintf(inst->loading_status, sizeof(inst->loading_status), "Warming up...");
-    for (int i = 0; i < 100000; i++) {
-        inst->mcu->updateSC55(1);
+    /* Warmup, or restore the state a previous launch reached after it */
+    WarmbootHeader warmboot;
+    v2_warmboot_header(inst, &warmboot);
+    if (!v2_load_warmboot(inst, &warmboot)) {
+        fprintf(stderr, "JV880 v2: Running warmup...\n");
+        snprintf(inst->loading_status, sizeof(inst->loading_status), "Warming up...");
+        for (int i = 0; i < 100000; i++) {
+            inst->mcu->updateSC55(1);
+        }
+        fprintf(stderr, "JV880 v2: Warmup done\n");
+        v2_save_warmboot(inst, &warmboot);
     }
-    fprintf(stderr, "JV880 v2: Warmup done\n");
+    v2_capture_mode_snapshot(inst, inst->performance_mode);
 
     /* Pre-fill audio buffer */
-    inst->ring_write = 0;
-    inst->ring_read = 0;
+    inst->ring.Reset();
 
-    /* Initialize high-quality resampler (66207 Hz -> 48000 Hz) */
-    double ratio = (double)MOVE_SAMPLE_RATE / (double)JV880_SAMPLE_RATE;
-    inst->resampleL = resample_open(1, ratio, ratio);  /* High quality */
-    inst->resampleR = resample_open(1, ratio, ratio);
-    fprintf(stderr, "JV880 v2: Resampler initialized (ratio %.4f)\n", ratio);
+    /* Initialize resampler; banks for 64 or 32 kHz input are built on first use */
+    inst->resampler.Init(PolyphaseResampler::DEFAULT_QUALITY);
+    fprintf(stderr, "JV880 v2: Resampler initialized (%s, %d/%d)\n",
+            PolyphaseResampler::QUALITY[PolyphaseResampler::DEFAULT_QUALITY].name,
+            MOVE_SAMPLE_RATE, v2_core_rate(inst));
 
     fprintf(stderr, "JV880 v2: Pre-filling buffer...\n");
     snprintf(inst->loading_status, sizeof(inst->loading_status), "Preparing audio...");
-    for (int i = 0; i < 256 && inst->ring_write < AUDIO_RING_SIZE / 2; i++) {
+    for (int i = 0; i < 256 && inst->ring.Available() < inst->ring_target / 2; i++) {
         inst->mcu->updateSC55(8);
         int avail = inst->mcu->sample_write_ptr;
         int in_samples = avail / 2;
 
         if (in_samples > 0 && in_samples < 4096) {
-            /* Convert int16 to float for resampler */
-            for (int j = 0; j < in_samples; j++) {
-                inst->resample_in_l[j] = (float)inst->mcu->sample_buffer[j * 2] / 32768.0f;
-                inst->resample_in_r[j] = (float)inst->mcu->sample_buffer[j * 2 + 1] / 32768.0f;
-            }
+            int out_samples = v2_resample(inst, in_samples);
 
-            /* Resample */
-            int inUsedL = 0, inUsedR = 0;
-            int outL = resample_process(inst->resampleL, ratio, inst->resample_in_l, in_samples,
-                                        0, &inUsedL, inst->resample_out_l, 4096);
-            int outR = resample_process(inst->resampleR, ratio, inst->resample_in_r, in_samples,
-                                        0, &inUsedR, inst->resample_out_r, 4096);
-            int out_samples = (outL < outR) ? outL : outR;
-
-            /* Copy to ring buffer */
-            for (int j = 0; j < out_samples && inst->ring_write < AUDIO_RING_SIZE / 2; j++) {
-                int32_t l = (int32_t)(inst->resample_out_l[j] * 32768.0f);
-                int32_t r = (int32_t)(inst->resample_out_r[j] * 32768.0f);
-                if (l > 32767) l = 32767; if (l < -32768) l = -32768;
-                if (r > 32767) r = 32767; if (r < -32768) r = -32768;
-                inst->audio_ring[inst->ring_write * 2 + 0] = (int16_t)l;
-                inst->audio_ring[inst->ring_write * 2 + 1] = (int16_t)r;
-                inst->ring_write = (inst->ring_write + 1) % AUDIO_RING_SIZE;
-            }
+            /* Copy to ring buffer, up to half full */
+            int room = inst->ring_target / 2 - inst->ring.Available();
+            inst->ring.Write(inst->resample_out, out_samples < room ? out_samples : room);
         }
     }
-    fprintf(stderr, "JV880 v2: Buffer pre-filled: %d samples\n", inst->ring_write);
+    fprintf(stderr, "JV880 v2: Buffer pre-filled: %d samples\n", inst->ring.Available());
 
     /* Start emulation thread - set initialized BEFORE pthread_create so
      * render_block and on_midi can start working with the pre-filled buffer
@@ -1216,12 +1410,19 @@ static void* v2_create_instance(const char *module_dir, const char *json_default
     }
 
     /* Initialize mutex */
-    pthread_mutex_init(&inst->ring_mutex, NULL);
+    pthread_mutex_init(&inst->midi_mutex, NULL);
+    sem_init(&inst->emu_wake, 0, 0);
 
     /* Initialize loading status */
     snprintf(inst->loading_status, sizeof(inst->loading_status), "Initializing...");
     inst->current_expansion = -1;
     inst->found_perf_sram_offset = -1;
+    inst->snapshot_capture_mode = -1;
+    inst->pending_restore_mode = -1;
+    inst->reset_request = -1;
+    inst->output_mode_request = -1;
+    inst->latency_request = -1;
+    v2_set_latency_profile(inst, LATENCY_DEFAULT);
     inst->map_last_offset = -1;
 
     /* Create emulator instance */
@@ -1238,7 +1439,8 @@ static void* v2_create_instance(const char *module_dir, const char *json_default
         fprintf(stderr, "JV880 v2: Memory allocation failed\n");
         free(rom1); free(rom2); free(waverom1); free(waverom2); free(nvram);
         delete inst->mcu;
-        pthread_mutex_destroy(&inst->ring_mutex);
+        pthread_mutex_destroy(&inst->midi_mutex);
+        sem_destroy(&inst->emu_wake);
         free(inst);
         return NULL;
     }
@@ -1276,6 +1478,12 @@ static void* v2_create_instance(const char *module_dir, const char *json_default
     /* Initialize emulator */
     inst->mcu->startSC55(rom1, rom2, waverom1, waverom2, nvram);
 
+    /* Key for the warm-boot image */
+    inst->rom_crc[0] = crc32_update(0, rom1, ROM1_SIZE);
+    inst->rom_crc[1] = crc32_update(0, rom2, ROM2_SIZE);
+    inst->rom_crc[2] = crc32_update(0, waverom1, 0x200000);
+    inst->rom_crc[3] = crc32_update(0, waverom2, 0x200000);
+
     /* Keep ROM2 for internal patch access */
     inst->rom2 = rom2;
 
@@ -1310,18 +1518,12 @@ static void v2_destroy_instance(void *instance) {
     /* Stop emulator thread */
     if (inst->thread_running) {
         inst->thread_running = 0;
+        sem_post(&inst->emu_wake);
         pthread_join(inst->emu_thread, NULL);
     }
 
     /* Cleanup resampler */
-    if (inst->resampleL) {
-        resample_close(inst->resampleL);
-        inst->resampleL = nullptr;
-    }
-    if (inst->resampleR) {
-        resample_close(inst->resampleR);
-        inst->resampleR = nullptr;
-    }
+    inst->resampler.Free();
 
     /* Cleanup emulator */
     if (inst->mcu) {
@@ -1329,6 +1531,12 @@ static void v2_destroy_instance(void *instance) {
         inst->mcu = nullptr;
     }
 
+    /* Free mode snapshots */
+    for (int i = 0; i < 2; i++) {
+        free(inst->mode_snapshot[i]);
+        inst->mode_snapshot[i] = nullptr;
+    }
+
     /* Free ROM2 */
     if (inst->rom2) {
         free(inst->rom2);
@@ -1343,7 +1551,8 @@ static void v2_destroy_instance(void *instance) {
         }
     }
 
-    pthread_mutex_destroy(&inst->ring_mutex);
+    pthread_mutex_destroy(&inst->midi_mutex);
+    sem_destroy(&inst->emu_wake);
     free(inst);
     fprintf(stderr, "JV880 v2: Instance destroyed\n");
 }
@@ -1373,23 +1582,119 @@ static int v2_load_rom(jv880_instance_t *inst, const char *filename, uint8_t *de
 
 /* v2: Ring buffer helpers (instance-based) */
 static int v2_ring_available(jv880_instance_t *inst) {
-    int avail = inst->ring_write - inst->ring_read;
-    if (avail < 0) avail += AUDIO_RING_SIZE;
-    return avail;
+    return inst->ring.Available();
 }
 
+/* Free frames below the latency target (negative after it was lowered) */
 static int v2_ring_free(jv880_instance_t *inst) {
-    return AUDIO_RING_SIZE - 1 - v2_ring_available(inst);
+    return inst->ring_target - inst->ring.Available();
+}
+
+static double v2_now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* v2: Voice governor step, once per rendered block (see GOV_*) */
+static void v2_voice_governor(jv880_instance_t *inst, double busy_sec, int in_samples) {
+    double audio_sec = (double)in_samples / v2_core_rate(inst);
+    inst->emu_load += ((float)(busy_sec / audio_sec) - inst->emu_load) * (1.0f / 16.0f);
+
+    if (++inst->governor_blocks < GOV_INTERVAL_BLOCKS)
+        return;
+    inst->governor_blocks = 0;
+
+    int underruns = inst->underrun_count;
+    int underrun = underruns != inst->governor_underruns;
+    inst->governor_underruns = underruns;
+
+    int limit = inst->mcu->pcm.voice_limit;
+    if (!inst->voice_governor) {
+        if (limit < 32)
+            inst->mcu->MCU_PCM_SetVoiceLimit(32);
+        return;
+    }
+
+    int active = __builtin_popcount(inst->mcu->pcm.meter.active_mask.load());
+    if ((underrun || inst->emu_load > GOV_LOAD_HIGH) && active > GOV_MIN_VOICES) {
+        int target = ((active < limit) ? active : limit) - 2;
+        if (target < GOV_MIN_VOICES)
+            target = GOV_MIN_VOICES;
+        if (target < limit) {
+            jv_debug("[governor] load %.2f underrun %d: voice limit %d\n",
+                     inst->emu_load, underrun, target);
+            inst->mcu->MCU_PCM_SetVoiceLimit(target);
+        }
+    } else if (inst->emu_load < GOV_LOAD_LOW && limit < 32) {
+        limit = (limit + 1 >= 28) ? 32 : limit + 1;
+        inst->mcu->MCU_PCM_SetVoiceLimit(limit);
+    }
 }
 
 /* v2: Emulator thread */
+/* Sleep until render_block wakes us (ring has refill_free free) or the
+ * timeout. emu_sleeping is set before the ring is re-checked, and
+ * render_block reads the flag after draining (both fenced), so one of the
+ * two always sees the other and the wakeup isn't lost. The deadline is
+ * monotonic so a wall-clock step (NTP at boot) can't stretch the timeout. */
+static void v2_emu_wait(jv880_instance_t *inst) {
+    inst->emu_sleeping.store(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (v2_ring_free(inst) < inst->refill_free && inst->thread_running) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        ts.tv_nsec += EMU_WAIT_TIMEOUT_US * 1000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        while (sem_clockwait(&inst->emu_wake, CLOCK_MONOTONIC, &ts) != 0 &&
+               errno == EINTR) {
+        }
+    }
+    inst->emu_sleeping.store(0);
+}
+
 static void* v2_emu_thread_func(void *arg) {
     jv880_instance_t *inst = (jv880_instance_t*)arg;
     fprintf(stderr, "JV880 v2: Emulation thread started\n");
 
-    const double ratio = (double)MOVE_SAMPLE_RATE / (double)JV880_SAMPLE_RATE;
-
     while (inst->thread_running) {
+        /* Apply a mode snapshot queued by v2_set_mode */
+        int restore_mode = inst->pending_restore_mode;
+        if (restore_mode >= 0) {
+            inst->pending_restore_mode = -1;
+            v2_restore_mode_snapshot(inst, restore_mode);
+            inst->governor_rebase = 1;
+        }
+
+        /* Reset queued by v2_set_mode or an expansion load. The emu thread
+         * owns the MCU, so it resets here */
+        int reset_warmup = inst->reset_request;
+        if (reset_warmup >= 0) {
+            inst->reset_request = -1;
+            inst->mcu->SC55_Reset();
+            inst->warmup_remaining = reset_warmup;
+            inst->governor_rebase = 1;
+        }
+
+        /* Switch output rate between blocks; the resampler rebuilds its banks
+         * for the new rate on the next block */
+        int output_mode = inst->output_mode_request;
+        if (output_mode >= 0) {
+            inst->output_mode_request = -1;
+            inst->mcu->MCU_PCM_SetOutputMode(output_mode);
+            inst->output_mode = output_mode;
+        }
+
+        /* New latency profile: takes effect from the next refill */
+        int latency = inst->latency_request;
+        if (latency >= 0) {
+            inst->latency_request = -1;
+            v2_set_latency_profile(inst, latency);
+        }
+
         /* Handle warmup after SC55_Reset */
         if (inst->warmup_remaining > 0) {
             int batch = (inst->warmup_remaining > 1000) ? 1000 : inst->warmup_remaining;
@@ -1398,6 +1703,11 @@ static void* v2_emu_thread_func(void *arg) {
             }
             inst->warmup_remaining -= batch;
             if (inst->warmup_remaining <= 0) {
+                int capture_mode = inst->snapshot_capture_mode;
+                if (capture_mode >= 0) {
+                    inst->snapshot_capture_mode = -1;
+                    v2_capture_mode_snapshot(inst, capture_mode);
+                }
                 snprintf(inst->loading_status, sizeof(inst->loading_status),
                          "Ready: %d patches", inst->total_patches);
                 jv_debug("[v2_emu_thread] Warmup complete\n");
@@ -1420,49 +1730,32 @@ static void* v2_emu_thread_func(void *arg) {
 
         /* Check if we need more audio */
         int free_space = v2_ring_free(inst);
-        if (free_space < 64) {
-            usleep(50);
+        if (free_space < inst->refill_free) {
+            /* Back at the ring target after a reset or restore: the
+             * governor starts over from here */
+            if (inst->governor_rebase) {
+                inst->governor_rebase = 0;
+                inst->governor_blocks = 0;
+                inst->governor_underruns = inst->underrun_count;
+            }
+            v2_emu_wait(inst);
             continue;
         }
 
-        inst->mcu->updateSC55(64);
+        double block_start = v2_now_sec();
+        inst->mcu->updateSC55(inst->emu_chunk);
         int avail = inst->mcu->sample_write_ptr;
         int in_samples = avail / 2;  /* Stereo pairs */
 
         if (in_samples > 0 && in_samples < 4096) {
-            /* Convert int16 to float for resampler (separate L/R channels) */
-            for (int i = 0; i < in_samples; i++) {
-                inst->resample_in_l[i] = (float)inst->mcu->sample_buffer[i * 2] / 32768.0f;
-                inst->resample_in_r[i] = (float)inst->mcu->sample_buffer[i * 2 + 1] / 32768.0f;
-            }
+            /* Resample straight from the core's interleaved 20-bit buffer */
+            int out_samples = v2_resample(inst, in_samples);
 
-            /* Resample using high-quality polyphase filter */
-            int inUsedL = 0, inUsedR = 0;
-            int outL = resample_process(inst->resampleL, ratio, inst->resample_in_l, in_samples,
-                                        0, &inUsedL, inst->resample_out_l, 4096);
-            int outR = resample_process(inst->resampleR, ratio, inst->resample_in_r, in_samples,
-                                        0, &inUsedR, inst->resample_out_r, 4096);
-
-            int out_samples = (outL < outR) ? outL : outR;
-
-            /* Batch copy to ring buffer with single lock */
-            if (out_samples > 0) {
-                pthread_mutex_lock(&inst->ring_mutex);
-                int free_now = v2_ring_free(inst);
-                int to_write = (out_samples < free_now) ? out_samples : free_now;
-                for (int i = 0; i < to_write; i++) {
-                    int wr = inst->ring_write;
-                    /* Convert float back to int16 */
-                    int32_t l = (int32_t)(inst->resample_out_l[i] * 32768.0f);
-                    int32_t r = (int32_t)(inst->resample_out_r[i] * 32768.0f);
-                    if (l > 32767) l = 32767; if (l < -32768) l = -32768;
-                    if (r > 32767) r = 32767; if (r < -32768) r = -32768;
-                    inst->audio_ring[wr * 2 + 0] = (int16_t)l;
-                    inst->audio_ring[wr * 2 + 1] = (int16_t)r;
-                    inst->ring_write = (wr + 1) % AUDIO_RING_SIZE;
-                }
-                pthread_mutex_unlock(&inst->ring_mutex);
-            }
+            /* Publish to the ring; anything past its free space is dropped */
+            if (out_samples > 0)
+                inst->ring.Write(inst->resample_out, out_samples);
+
+            v2_voice_governor(inst, v2_now_sec() - block_start, in_samples);
         }
     }
 
@@ -1691,6 +1984,34 @@ static void v2_jump_to_bank(jv880_instance_t *inst, int direction) {
     fprintf(stderr, "JV880 v2: Jumped to bank %d: %s\n", new_bank, inst->bank_names[new_bank]);
 }
 
+/* v2: Keep the current (just warmed up) machine state for instant switches
+ * back into this mode. Runs on whichever thread is driving the emulator. */
+static void v2_capture_mode_snapshot(jv880_instance_t *inst, int mode) {
+    if (!inst->mode_snapshot[mode]) {
+        inst->mode_snapshot[mode] = (mcu_state_t*)malloc(sizeof(mcu_state_t));
+        if (!inst->mode_snapshot[mode]) return;
+    }
+    inst->mcu->MCU_SaveState(inst->mode_snapshot[mode]);
+    inst->mode_snapshot_expansion[mode] = inst->current_expansion;
+    fprintf(stderr, "JV880 v2: Captured %s mode snapshot (%zu bytes)\n",
+            mode ? "performance" : "patch", sizeof(mcu_state_t));
+}
+
+/* v2: Load a mode snapshot. Emu thread only. NVRAM holds the selected
+ * patch and user settings, so the live copy is kept with just the mode
+ * byte switched. */
+static void v2_restore_mode_snapshot(jv880_instance_t *inst, int mode) {
+    mcu_state_t *snap = inst->mode_snapshot[mode];
+    if (!snap) return;
+    memcpy(snap->nvram, inst->mcu->nvram, NVRAM_SIZE);
+    snap->nvram[NVRAM_MODE_OFFSET] = mode ? 0 : 1;
+    inst->mcu->MCU_LoadState(snap);
+    snprintf(inst->loading_status, sizeof(inst->loading_status),
+             "Ready: %d patches", inst->total_patches);
+    jv_debug("[v2_emu_thread] Restored %s mode snapshot\n",
+            mode ? "performance" : "patch");
+}
+
 /* v2: Switch between patch and performance mode */
 static void v2_set_mode(jv880_instance_t *inst, int performance_mode) {
     if (!inst || !inst->mcu) {
@@ -1716,7 +2037,7 @@ static void v2_set_mode(jv880_instance_t *inst, int performance_mode) {
             new_mode ? "Performance" : "Patch");
 
     /* Send All Notes Off on all channels before mode switch */
-    pthread_mutex_lock(&inst->ring_mutex);
+    pthread_mutex_lock(&inst->midi_mutex);
     for (int ch = 0; ch < 16; ch++) {
         uint8_t notes_off[3] = { (uint8_t)(0xB0 | ch), 123, 0 };
         int next = (inst->midi_write + 1) % MIDI_QUEUE_SIZE;
@@ -1726,7 +2047,7 @@ static void v2_set_mode(jv880_instance_t *inst, int performance_mode) {
             inst->midi_write = next;
         }
     }
-    pthread_mutex_unlock(&inst->ring_mutex);
+    pthread_mutex_unlock(&inst->midi_mutex);
     jv_debug("[v2_set_mode] Sent All Notes Off on all 16 channels\n");
 
     /* Update mode state */
@@ -1737,20 +2058,37 @@ static void v2_set_mode(jv880_instance_t *inst, int performance_mode) {
     inst->mcu->nvram[NVRAM_MODE_OFFSET] = desired_nvram_mode;
     jv_debug("[v2_set_mode] Set NVRAM[0x%x] = %d\n", NVRAM_MODE_OFFSET, desired_nvram_mode);
 
-    /* Reset emulator for clean state - don't use button press which can cause conflicts */
-    jv_debug("[v2_set_mode] Resetting emulator for clean mode switch\n");
-    inst->mcu->SC55_Reset();
-    snprintf(inst->loading_status, sizeof(inst->loading_status), "Warming up...");
-    inst->warmup_remaining = 100000;  /* Same as initial warmup */
+    /* A snapshot of this mode taken after an earlier warmup replaces the
+     * reset + warmup. It is only valid with the same expansion loaded,
+     * since the firmware scans the card while booting. */
+    int select_delay;
+    if (inst->mode_snapshot[new_mode] &&
+        inst->mode_snapshot_expansion[new_mode] == inst->current_expansion) {
+        jv_debug("[v2_set_mode] Restoring %s mode snapshot\n",
+                new_mode ? "Performance" : "Patch");
+        inst->snapshot_capture_mode = -1;
+        inst->warmup_remaining = 0;
+        inst->reset_request = -1;
+        inst->pending_restore_mode = new_mode;
+        select_delay = 2;  /* Snapshot is already warm */
+    } else {
+        /* Reset emulator for clean state - don't use button press which can cause conflicts */
+        jv_debug("[v2_set_mode] Resetting emulator for clean mode switch\n");
+        inst->pending_restore_mode = -1;
+        snprintf(inst->loading_status, sizeof(inst->loading_status), "Warming up...");
+        inst->snapshot_capture_mode = new_mode;
+        inst->reset_request = 100000;  /* Same warmup as initial */
+        select_delay = 50;  /* Delay to allow warmup to complete */
+    }
 
     if (!inst->performance_mode) {
         /* Entering patch mode */
         jv_debug("[v2_set_mode] Entering patch mode, setting pending_patch_select\n");
-        inst->pending_patch_select = 50;  /* Delay to allow warmup to complete */
+        inst->pending_patch_select = select_delay;
     } else {
         /* Entering performance mode */
         jv_debug("[v2_set_mode] Entering performance mode, setting pending_perf_select\n");
-        inst->pending_perf_select = 50;  /* Same delay as patch mode */
+        inst->pending_perf_select = select_delay;
     }
 
     jv_debug("[v2_set_mode] Complete\n");
@@ -1812,7 +2150,7 @@ static void v2_select_performance(jv880_instance_t *inst, int perf_index) {
     uint8_t pc_msg[2] = { (uint8_t)(0xC0 | ctrl_ch), pc_value };
 
     /* Queue Bank Select (CC#0) */
-    pthread_mutex_lock(&inst->ring_mutex);
+    pthread_mutex_lock(&inst->midi_mutex);
     int next = (inst->midi_write + 1) % MIDI_QUEUE_SIZE;
     if (next != inst->midi_read) {
         memcpy(inst->midi_queue[inst->midi_write], bank_msg, 3);
@@ -1835,7 +2173,7 @@ static void v2_select_performance(jv880_instance_t *inst, int perf_index) {
     } else {
         jv_debug("[v2_select_performance] ERROR: MIDI queue full for PC!\n");
     }
-    pthread_mutex_unlock(&inst->ring_mutex);
+    pthread_mutex_unlock(&inst->midi_mutex);
 
     jv_debug("[v2_select_performance] Complete\n");
 
@@ -1942,14 +2280,14 @@ static void v2_set_param(void *instance, const char *key, const char *val) {
                     }
                     /* Send PC 0 to trigger emulator to reload from NVRAM */
                     uint8_t pc_msg[2] = { 0xC0, 0x00 };
-                    pthread_mutex_lock(&inst->ring_mutex);
+                    pthread_mutex_lock(&inst->midi_mutex);
                     int next = (inst->midi_write + 1) % MIDI_QUEUE_SIZE;
                     if (next != inst->midi_read) {
                         memcpy(inst->midi_queue[inst->midi_write], pc_msg, 2);
                         inst->midi_queue_len[inst->midi_write] = 2;
                         inst->midi_write = next;
                     }
-                    pthread_mutex_unlock(&inst->ring_mutex);
+                    pthread_mutex_unlock(&inst->midi_mutex);
                     fprintf(stderr, "JV880 v2: Restored working patch from state\n");
                 }
             }
@@ -1983,6 +2321,18 @@ static void v2_set_param(void *instance, const char *key, const char *val) {
             v2_send_all_notes_off(inst);
         }
         inst->octave_transpose = v;
+    } else if (strcmp(key, "voice_governor") == 0) {
+        inst->voice_governor = atoi(val) ? 1 : 0;
+    } else if (strcmp(key, "output_mode") == 0) {
+        for (int i = 0; i < 3; i++) {
+            if (strcmp(val, v2_output_mode_names[i]) == 0)
+                inst->output_mode_request = i;
+        }
+    } else if (strcmp(key, "latency") == 0) {
+        for (int i = 0; i < LATENCY_PROFILE_COUNT; i++) {
+            if (strcmp(val, v2_latency_profiles[i].name) == 0)
+                inst->latency_request = i;
+        }
     } else if (strcmp(key, "program_change") == 0) {
         int program = atoi(val);
         if (program >= 0 && program < inst->total_patches && program != inst->current_patch) {
@@ -2525,14 +2875,14 @@ static void v2_set_param(void *instance, const char *key, const char *val) {
 
                 /* Trigger emulator to reload patch via PC 0 */
                 uint8_t pc_msg[2] = { 0xC0, 0x00 };
-                pthread_mutex_lock(&inst->ring_mutex);
+                pthread_mutex_lock(&inst->midi_mutex);
                 int next = (inst->midi_write + 1) % MIDI_QUEUE_SIZE;
                 if (next != inst->midi_read) {
                     memcpy(inst->midi_queue[inst->midi_write], pc_msg, 2);
                     inst->midi_queue_len[inst->midi_write] = 2;
                     inst->midi_write = next;
                 }
-                pthread_mutex_unlock(&inst->ring_mutex);
+                pthread_mutex_unlock(&inst->midi_mutex);
             } else {
                 fprintf(stderr, "JV880 v2: User patch slot %d is empty\n", slot + 1);
             }
@@ -2917,6 +3267,19 @@ static int v2_get_param(void *instance, const char *key, char *buf, int buf_len)
     if (strcmp(key, "octave_transpose") == 0) {
         return snprintf(buf, buf_len, "%d", inst->octave_transpose);
     }
+    if (strcmp(key, "output_mode") == 0) {
+        return snprintf(buf, buf_len, "%s", v2_output_mode_names[inst->output_mode]);
+    }
+    if (strcmp(key, "output_rate") == 0) {
+        int rate = inst->mcu ? v2_core_rate(inst) : 0;
+        return snprintf(buf, buf_len, "%d", rate);
+    }
+    if (strcmp(key, "latency") == 0) {
+        return snprintf(buf, buf_len, "%s", v2_latency_profiles[inst->latency_profile].name);
+    }
+    if (strcmp(key, "latency_ms") == 0 && inst->mcu) {
+        return snprintf(buf, buf_len, "%.1f", v2_latency_ms(inst));
+    }
     /* State serialization for patch save/load */
     if (strcmp(key, "state") == 0) {
         int written = snprintf(buf, buf_len,
@@ -2951,12 +3314,49 @@ static int v2_get_param(void *instance, const char *key, char *buf, int buf_len)
     if (strcmp(key, "audio_diag") == 0) {
         int avail = v2_ring_available(inst);
         return snprintf(buf, buf_len, "underruns=%d renders=%d ring=%d/%d min=%d",
-                inst->underrun_count, inst->render_count, avail, AUDIO_RING_SIZE,
+                inst->underrun_count, inst->render_count, avail, inst->ring_target,
                 inst->min_buffer_level);
     }
     if (strcmp(key, "polyphony") == 0) {
         return snprintf(buf, buf_len, "28");
     }
+    /* Voice metering; peaks are reset when read */
+    if (strcmp(key, "voices_active") == 0 && inst->mcu) {
+        return snprintf(buf, buf_len, "%d", __builtin_popcount(inst->mcu->pcm.meter.active_mask.load()));
+    }
+    if (strcmp(key, "voices_peak") == 0 && inst->mcu) {
+        pcm_meter_t *meter = &inst->mcu->pcm.meter;
+        int peak = meter->active_peak.exchange(__builtin_popcount(meter->active_mask.load()));
+        return snprintf(buf, buf_len, "%d", peak);
+    }
+    if (strcmp(key, "voices_bitmap") == 0 && inst->mcu) {
+        return snprintf(buf, buf_len, "%08x", inst->mcu->pcm.meter.active_mask.load());
+    }
+    if (strcmp(key, "voice_levels") == 0 && inst->mcu) {
+        /* Per slot TVA level scaled to 0-127, comma separated */
+        int written = 0;
+        for (int i = 0; i < 32 && written < buf_len - 5; i++) {
+            written += snprintf(buf + written, buf_len - written, i ? ",%d" : "%d",
+                                inst->mcu->pcm.meter.level[i].load(std::memory_order_relaxed) / 127);
+        }
+        return written;
+    }
+    if (strcmp(key, "voice_governor") == 0) {
+        return snprintf(buf, buf_len, "%d", inst->voice_governor);
+    }
+    if (strcmp(key, "voice_limit") == 0 && inst->mcu) {
+        return snprintf(buf, buf_len, "%d", inst->mcu->pcm.voice_limit);
+    }
+    if (strcmp(key, "voices_stolen") == 0 && inst->mcu) {
+        return snprintf(buf, buf_len, "%d", __builtin_popcount(inst->mcu->pcm.voice_stolen.load(std::memory_order_relaxed)));
+    }
+    if (strcmp(key, "cpu_load") == 0) {
+        return snprintf(buf, buf_len, "%d", (int)(inst->emu_load * 100.0f + 0.5f));
+    }
+    if (strcmp(key, "output_peak") == 0 && inst->mcu) {
+        int peak = inst->mcu->pcm.meter.out_peak.exchange(0);
+        return snprintf(buf, buf_len, "%d", peak);
+    }
     /* Bank information */
     if (strcmp(key, "bank_count") == 0) {
         return snprintf(buf, buf_len, "%d", inst->bank_count);
@@ -3512,6 +3912,18 @@ static int v2_get_error(void *instance, char *buf, int buf_len) {
     return len;
 }
 
+/* The only int16 conversion on the audio path: output gain, then TPDF
+ * dither of +-1 LSB from two LCG draws */
+static inline int16_t v2_output_sample(jv880_instance_t *inst, float x) {
+    uint32_t a = inst->dither_seed = inst->dither_seed * 1664525u + 1013904223u;
+    uint32_t b = inst->dither_seed = inst->dither_seed * 1664525u + 1013904223u;
+    float tpdf = ((float)(a >> 16) - (float)(b >> 16)) * (1.0f / 65536.0f);
+    int32_t v = (int32_t)lrintf(x * (OUTPUT_GAIN * 32768.0f) + tpdf);
+    if (v > 32767) v = 32767;
+    if (v < -32768) v = -32768;
+    return (int16_t)v;
+}
+
 /* v2: Render block */
 static void v2_render_block(void *instance, int16_t *out, int frames) {
     jv880_instance_t *inst = (jv880_instance_t*)instance;
@@ -3520,9 +3932,7 @@ static void v2_render_block(void *instance, int16_t *out, int frames) {
         return;
     }
 
-    pthread_mutex_lock(&inst->ring_mutex);
     int avail = v2_ring_available(inst);
-    int to_read = (avail < frames) ? avail : frames;
 
     /* Track buffer levels for diagnostics */
     inst->render_count++;
@@ -3530,12 +3940,26 @@ static void v2_render_block(void *instance, int16_t *out, int frames) {
         inst->min_buffer_level = avail;
     }
 
-    for (int i = 0; i < to_read; i++) {
-        out[i * 2 + 0] = inst->audio_ring[inst->ring_read * 2 + 0] >> OUTPUT_GAIN_SHIFT;
-        out[i * 2 + 1] = inst->audio_ring[inst->ring_read * 2 + 1] >> OUTPUT_GAIN_SHIFT;
-        inst->ring_read = (inst->ring_read + 1) % AUDIO_RING_SIZE;
+    /* Lock-free read in chunks, then gain/dither to int16 */
+    float chunk[256 * 2];
+    int to_read = 0;
+    while (to_read < frames) {
+        int want = frames - to_read;
+        if (want > 256) want = 256;
+        int got = inst->ring.Read(chunk, want);
+        for (int i = 0; i < got * 2; i++)
+            out[to_read * 2 + i] = v2_output_sample(inst, chunk[i]);
+        to_read += got;
+        if (got < want) break;
+    }
+
+    /* Wake the emu thread once there is room for it again; sem_post
+     * doesn't block, and only one post is made per sleep */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (v2_ring_free(inst) >= inst->refill_free && inst->emu_sleeping.load() &&
+        inst->emu_sleeping.exchange(0)) {
+        sem_post(&inst->emu_wake);
     }
-    pthread_mutex_unlock(&inst->ring_mutex);
 
     /* Pad with silence if underrun */
     if (to_read < frames) {
@@ -3549,8 +3973,9 @@ static void v2_render_block(void *instance, int16_t *out, int frames) {
         out[i * 2 + 1] = 0;
     }
 
-    /* Handle deferred selections - only after warmup is complete */
-    if (inst->warmup_remaining <= 0) {
+    /* Handle deferred selections - only after warmup or restore is complete */
+    if (inst->warmup_remaining <= 0 && inst->reset_request < 0 &&
+        inst->pending_restore_mode < 0) {
         /* Handle deferred performance selection after mode switch has been processed */
         if (inst->pending_perf_select > 0) {
             inst->pending_perf_select--;
@@ -34,6 +34,7 @@
 #include "mcu.h"
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 #include <cstdlib>
 
 #if __linux__
@@ -41,7 +42,7 @@
 #include <unistd.h>
 #endif
 
-void MCU::MCU_ErrorTrap() { printf("trap %.2x %.4x\n", mcu.cp, mcu.pc); }
+void MCU::MCU_ErrorTrap() { fprintf(stderr, "trap %.2x %.4x\n", mcu.cp, mcu.pc); }
 
 uint16_t MCU::MCU_AnalogReadPin(const uint32_t pin) {
   if (pin == 1)
@@ -58,6 +59,7 @@ void MCU::MCU_AnalogSample(const int channel) {
 
 void MCU::MCU_DeviceWrite(uint32_t address, const uint8_t data) {
   address &= 0x7f;
+  MCU_WakeEvents();
   if (address >= 0x10 && address < 0x40) {
     TIMER_Write(address, data);
     return;
@@ -164,6 +166,11 @@ void MCU::MCU_DeviceWrite(uint32_t address, const uint8_t data) {
     break;
   }
   dev_register[address] = data;
+  if (address == DEV_RAME)
+    MCU_UpdateMemoryMap();
+  else if (address == DEV_P1CR ||
+           (address >= DEV_IPRA && address <= DEV_IPRD))
+    MCU_Interrupt_UpdateLevel();
 }
 
 uint8_t MCU::MCU_DeviceRead(uint32_t address) {
@@ -244,6 +251,7 @@ uint8_t MCU::MCU_DeviceRead(uint32_t address) {
 void MCU::MCU_DeviceReset() {
   dev_register[DEV_RAME] = 0x80;
   dev_register[DEV_SSR] = 0x80;
+  MCU_UpdateMemoryMap();
 }
 
 void MCU::MCU_UpdateAnalog(const uint64_t cycles) {
@@ -272,7 +280,7 @@ void MCU::MCU_UpdateAnalog(const uint64_t cycles) {
     analog_end_time = 0;
 }
 
-uint8_t MCU::MCU_Read(uint32_t address) {
+uint8_t MCU::MCU_ReadIO(uint32_t address) {
   uint32_t address_rom = address & 0x3ffff;
   uint8_t page = (address >> 16) & 0xf;
   address &= 0xffff;
@@ -289,8 +297,11 @@ uint8_t MCU::MCU_Read(uint32_t address) {
         ret = sram[address & 0x7fff];
       else if (address >= 0xff80)
         ret = MCU_DeviceRead(address & 0x7f);
-      else if (address >= 0xf000 && address < 0xf400)
+      else if (address >= 0xf000 && address < 0xf400) {
+        pcm.PCM_Update(mcu.cycles);
         ret = pcm.PCM_Read(address & 0x3f);
+        MCU_PCM_Schedule();
+      }
       else if (address == 0xf402) {
         ret = ga_int_trigger;
         ga_int_trigger = 0;
@@ -330,7 +341,7 @@ uint8_t MCU::MCU_Read(uint32_t address) {
   return ret;
 }
 
-void MCU::MCU_Write(uint32_t address, const uint8_t value) {
+void MCU::MCU_WriteIO(uint32_t address, const uint8_t value) {
   uint8_t page = (address >> 16) & 0xf;
   address &= 0xffff;
   if (page == 0 && address & 0x8000) {
@@ -353,9 +364,11 @@ void MCU::MCU_Write(uint32_t address, const uint8_t value) {
         lcd.LCD_Write(0, value);
       else if (address == 0xf104)
         lcd.LCD_Write(1, value);
-    } else if (address >= 0xf000 && address < 0xf400)
+    } else if (address >= 0xf000 && address < 0xf400) {
+      pcm.PCM_Update(mcu.cycles);
       pcm.PCM_Write(address & 0x3f, value);
-    else if (address >= 0xff80)
+      MCU_PCM_Schedule();
+    } else if (address >= 0xff80)
       MCU_DeviceWrite(address & 0x7f, value);
     // else
     //     printf("Unknown write %x%04x\n", page, address);
@@ -369,6 +382,52 @@ void MCU::MCU_Write(uint32_t address, const uint8_t value) {
   //     printf("Unknown write %x%04x\n", page, address);
 }
 
+void MCU::MCU_UpdateMemoryMap() {
+  bool rame = (dev_register[DEV_RAME] & 0x80) != 0;
+  for (int i = 0; i < MEMORY_MAP_SIZE; i++) {
+    uint32_t page = i >> 8;
+    uint32_t address = (i & 0xff) << 8;
+    uint8_t *read = NULL;
+    uint8_t *write = NULL;
+    switch (page) {
+    case 0:
+      if (address < 0x8000)
+        read = &rom1[address];
+      else if (address < 0xe000)
+        read = write = &sram[address & 0x7fff];
+      else if (rame && address >= 0xfc00 && address < 0xff00)
+        read = write = &ram[(address - 0xfb80) & 0x3ff];
+      break;
+    case 1:
+    case 2:
+    case 3:
+    case 4:
+      read = &rom2[((page << 16) | address) & 0x3ffff & rom2_mask];
+      break;
+    case 10:
+    case 11:
+      read = &sram[address & 0x7fff];
+      if (page == 10)
+        write = read;
+      break;
+    case 12:
+    case 13:
+      read = &nvram[address & 0x7fff];
+      if (page == 12)
+        write = read;
+      break;
+    case 14:
+    case 15:
+      read = &cardram[address & 0x7fff];
+      if (page == 14)
+        write = read;
+      break;
+    }
+    mem_read_map[i] = read;
+    mem_write_map[i] = write;
+  }
+}
+
 void MCU::MCU_Init() { memset(&mcu, 0, sizeof(mcu_t)); }
 
 void MCU::MCU_Reset() {
@@ -405,6 +464,7 @@ void MCU::MCU_PostUART(const uint8_t data) {
     return;
   uart_buffer[uart_write_ptr] = data;
   uart_write_ptr = (uart_write_ptr + 1) % uart_buffer_size;
+  MCU_WakeEvent(EVENT_UART_RX);
 }
 
 void MCU::MCU_UpdateUART_RX() {
@@ -449,6 +509,10 @@ void MCU::MCU_PatchROM() {
   rom2[0x318f7] = 0x19;
 }
 
+void MCU::MCU_InvalidateDecodeCache() {
+  memset(decode_cache, 0, sizeof(decode_cache));
+}
+
 void unscramble(const uint8_t *src, uint8_t *dst, const int len) {
   for (int i = 0; i < len; i++) {
     int address = i & ~0xfffff;
@@ -483,97 +547,124 @@ void MCU::MCU_EncoderTrigger(const int dir) {
   MCU_GA_SetGAInt(dir == 0 ? 3 : 4, 1);
 }
 
+int32_t MCU::MCU_Interrupt_GetLevel(const uint32_t source, int32_t *vector) {
+  int32_t level = 0;
+  *vector = -1;
+  switch (source) {
+  case INTERRUPT_SOURCE_IRQ0:
+    if ((dev_register[DEV_P1CR] & 0x20) == 0)
+      return 0;
+    *vector = VECTOR_IRQ0;
+    level = (dev_register[DEV_IPRA] >> 4) & 7;
+    break;
+  case INTERRUPT_SOURCE_IRQ1:
+    if ((dev_register[DEV_P1CR] & 0x40) == 0)
+      return 0;
+    *vector = VECTOR_IRQ1;
+    level = (dev_register[DEV_IPRA] >> 0) & 7;
+    break;
+  case INTERRUPT_SOURCE_FRT0_OCIA:
+    *vector = VECTOR_INTERNAL_INTERRUPT_94;
+    level = (dev_register[DEV_IPRB] >> 4) & 7;
+    break;
+  case INTERRUPT_SOURCE_FRT0_OCIB:
+    *vector = VECTOR_INTERNAL_INTERRUPT_98;
+    level = (dev_register[DEV_IPRB] >> 4) & 7;
+    break;
+  case INTERRUPT_SOURCE_FRT0_FOVI:
+    *vector = VECTOR_INTERNAL_INTERRUPT_9C;
+    level = (dev_register[DEV_IPRB] >> 4) & 7;
+    break;
+  case INTERRUPT_SOURCE_FRT1_OCIA:
+    *vector = VECTOR_INTERNAL_INTERRUPT_A4;
+    level = (dev_register[DEV_IPRB] >> 0) & 7;
+    break;
+  case INTERRUPT_SOURCE_FRT1_OCIB:
+    *vector = VECTOR_INTERNAL_INTERRUPT_A8;
+    level = (dev_register[DEV_IPRB] >> 0) & 7;
+    break;
+  case INTERRUPT_SOURCE_FRT1_FOVI:
+    *vector = VECTOR_INTERNAL_INTERRUPT_AC;
+    level = (dev_register[DEV_IPRB] >> 0) & 7;
+    break;
+  case INTERRUPT_SOURCE_FRT2_OCIA:
+    *vector = VECTOR_INTERNAL_INTERRUPT_B4;
+    level = (dev_register[DEV_IPRC] >> 4) & 7;
+    break;
+  case INTERRUPT_SOURCE_FRT2_OCIB:
+    *vector = VECTOR_INTERNAL_INTERRUPT_B8;
+    level = (dev_register[DEV_IPRC] >> 4) & 7;
+    break;
+  case INTERRUPT_SOURCE_FRT2_FOVI:
+    *vector = VECTOR_INTERNAL_INTERRUPT_BC;
+    level = (dev_register[DEV_IPRC] >> 4) & 7;
+    break;
+  case INTERRUPT_SOURCE_TIMER_CMIA:
+    *vector = VECTOR_INTERNAL_INTERRUPT_C0;
+    level = (dev_register[DEV_IPRC] >> 0) & 7;
+    break;
+  case INTERRUPT_SOURCE_TIMER_CMIB:
+    *vector = VECTOR_INTERNAL_INTERRUPT_C4;
+    level = (dev_register[DEV_IPRC] >> 0) & 7;
+    break;
+  case INTERRUPT_SOURCE_TIMER_OVI:
+    *vector = VECTOR_INTERNAL_INTERRUPT_C8;
+    level = (dev_register[DEV_IPRC] >> 0) & 7;
+    break;
+  case INTERRUPT_SOURCE_ANALOG:
+    *vector = VECTOR_INTERNAL_INTERRUPT_E0;
+    level = (dev_register[DEV_IPRD] >> 0) & 7;
+    break;
+  case INTERRUPT_SOURCE_UART_RX:
+    *vector = VECTOR_INTERNAL_INTERRUPT_D4;
+    level = (dev_register[DEV_IPRD] >> 4) & 7;
+    break;
+  case INTERRUPT_SOURCE_UART_TX:
+    *vector = VECTOR_INTERNAL_INTERRUPT_D8;
+    level = (dev_register[DEV_IPRD] >> 4) & 7;
+    break;
+  default:
+    break;
+  }
+  return level;
+}
+
+// Only TRAPA #0-8 are serviced by MCU_Interrupt_Handle.
+static const uint16_t TRAPA_HANDLED_MASK = 0x1ff;
+
+void MCU::MCU_Interrupt_UpdateLevel() {
+  uint32_t pending = mcu.interrupt_mask >> (INTERRUPT_SOURCE_NMI + 1);
+  uint32_t i = INTERRUPT_SOURCE_NMI + 1;
+  int32_t max_level = 0;
+  for (; pending; pending >>= 1, i++) {
+    int32_t vector;
+    if (pending & 1)
+      max_level = std::max(max_level, MCU_Interrupt_GetLevel(i, &vector));
+  }
+  interrupt_level = max_level;
+}
+
 void MCU::MCU_Interrupt_Handle() {
+  if ((mcu.trapa_mask & TRAPA_HANDLED_MASK) == 0 &&
+      interrupt_level <= (int32_t)((mcu.sr >> 8) & 7))
+    return;
+
   uint32_t i;
   for (i = 0; i <= 8; i++) {
     if (mcu.trapa_pending[i]) {
       mcu.trapa_pending[i] = 0;
+      mcu.trapa_mask &= ~(1u << i);
       MCU_Interrupt_StartVector(VECTOR_TRAPA_0 + i, -1);
       return;
     }
   }
   uint32_t mask = (mcu.sr >> 8) & 7;
   for (i = INTERRUPT_SOURCE_NMI + 1; i < INTERRUPT_SOURCE_MAX; i++) {
-    int32_t vector = -1;
-    int32_t level = 0;
+    int32_t vector;
+    int32_t level;
     if (!mcu.interrupt_pending[i])
       continue;
-    switch (i) {
-    case INTERRUPT_SOURCE_IRQ0:
-      if ((dev_register[DEV_P1CR] & 0x20) == 0)
-        continue;
-      vector = VECTOR_IRQ0;
-      level = (dev_register[DEV_IPRA] >> 4) & 7;
-      break;
-    case INTERRUPT_SOURCE_IRQ1:
-      if ((dev_register[DEV_P1CR] & 0x40) == 0)
-        continue;
-      vector = VECTOR_IRQ1;
-      level = (dev_register[DEV_IPRA] >> 0) & 7;
-      break;
-    case INTERRUPT_SOURCE_FRT0_OCIA:
-      vector = VECTOR_INTERNAL_INTERRUPT_94;
-      level = (dev_register[DEV_IPRB] >> 4) & 7;
-      break;
-    case INTERRUPT_SOURCE_FRT0_OCIB:
-      vector = VECTOR_INTERNAL_INTERRUPT_98;
-      level = (dev_register[DEV_IPRB] >> 4) & 7;
-      break;
-    case INTERRUPT_SOURCE_FRT0_FOVI:
-      vector = VECTOR_INTERNAL_INTERRUPT_9C;
-      level = (dev_register[DEV_IPRB] >> 4) & 7;
-      break;
-    case INTERRUPT_SOURCE_FRT1_OCIA:
-      vector = VECTOR_INTERNAL_INTERRUPT_A4;
-      level = (dev_register[DEV_IPRB] >> 0) & 7;
-      break;
-    case INTERRUPT_SOURCE_FRT1_OCIB:
-      vector = VECTOR_INTERNAL_INTERRUPT_A8;
-      level = (dev_register[DEV_IPRB] >> 0) & 7;
-      break;
-    case INTERRUPT_SOURCE_FRT1_FOVI:
-      vector = VECTOR_INTERNAL_INTERRUPT_AC;
-      level = (dev_register[DEV_IPRB] >> 0) & 7;
-      break;
-    case INTERRUPT_SOURCE_FRT2_OCIA:
-      vector = VECTOR_INTERNAL_INTERRUPT_B4;
-      level = (dev_register[DEV_IPRC] >> 4) & 7;
-      break;
-    case INTERRUPT_SOURCE_FRT2_OCIB:
-      vector = VECTOR_INTERNAL_INTERRUPT_B8;
-      level = (dev_register[DEV_IPRC] >> 4) & 7;
-      break;
-    case INTERRUPT_SOURCE_FRT2_FOVI:
-      vector = VECTOR_INTERNAL_INTERRUPT_BC;
-      level = (dev_register[DEV_IPRC] >> 4) & 7;
-      break;
-    case INTERRUPT_SOURCE_TIMER_CMIA:
-      vector = VECTOR_INTERNAL_INTERRUPT_C0;
-      level = (dev_register[DEV_IPRC] >> 0) & 7;
-      break;
-    case INTERRUPT_SOURCE_TIMER_CMIB:
-      vector = VECTOR_INTERNAL_INTERRUPT_C4;
-      level = (dev_register[DEV_IPRC] >> 0) & 7;
-      break;
-    case INTERRUPT_SOURCE_TIMER_OVI:
-      vector = VECTOR_INTERNAL_INTERRUPT_C8;
-      level = (dev_register[DEV_IPRC] >> 0) & 7;
-      break;
-    case INTERRUPT_SOURCE_ANALOG:
-      vector = VECTOR_INTERNAL_INTERRUPT_E0;
-      level = (dev_register[DEV_IPRD] >> 0) & 7;
-      break;
-    case INTERRUPT_SOURCE_UART_RX:
-      vector = VECTOR_INTERNAL_INTERRUPT_D4;
-      level = (dev_register[DEV_IPRD] >> 4) & 7;
-      break;
-    case INTERRUPT_SOURCE_UART_TX:
-      vector = VECTOR_INTERNAL_INTERRUPT_D8;
-      level = (dev_register[DEV_IPRD] >> 4) & 7;
-      break;
-    default:
-      break;
-    }
+    level = MCU_Interrupt_GetLevel(i, &vector);
 
     if ((int32_t)mask < level) {
       MCU_Interrupt_StartVector(vector, level);
@@ -582,6 +673,12 @@ void MCU::MCU_Interrupt_Handle() {
   }
 }
 
+// Would MCU_Interrupt_Handle start a vector right now?
+bool MCU::MCU_Interrupt_Deliverable() {
+  return (mcu.trapa_mask & TRAPA_HANDLED_MASK) != 0 ||
+         interrupt_level > (int32_t)((mcu.sr >> 8) & 7);
+}
+
 void MCU::TIMER_Reset() {
   timer_tempreg = 0;
 
@@ -607,9 +704,11 @@ void MCU::TIMER_Reset() {
   timer0_ociea = false;
   timer1_ociea = false;
   timer2_ociea = false;
+  timer_cycles = mcu.cycles;
 }
 
 void MCU::TIMER_Write(const uint32_t address, const uint8_t data) {
+  TIMER_Sync();
   switch (address) {
   case DEV_FRT1_TCR:
     timer0_ociea = data == 0b00100000;
@@ -660,6 +759,7 @@ void MCU::TIMER_Write(const uint32_t address, const uint8_t data) {
 
 uint8_t MCU::TIMER_Read(const uint32_t address) {
   uint8_t ret;
+  TIMER_Sync();
   switch (address) {
   case DEV_FRT1_TCSR:
     ret = 0b01110001;
@@ -707,52 +807,208 @@ uint8_t MCU::TIMER_Read2(const uint32_t address) {
   return 0xff;
 }
 
-void MCU::TIMER_Clock(const uint64_t cycles) {
+void MCU::TIMER8_Clock(const uint64_t cycles) {
   if (timer8_enabled && (cycles & 0x3f) == 0) {
     timer8_cmfa = true;
     if (timer8_cmiea)
       MCU_Interrupt_SetRequest(INTERRUPT_SOURCE_TIMER_CMIA, 1);
   }
+}
+
+// Number of 12-cycle steps a free-running timer runs before the step on
+// which compare match A fires, or EVENT_NEVER.
+static uint64_t TIMER_FRT_StepsToMatch(uint16_t frc, const uint16_t ocra) {
+  if (ocra > 0x3fff)
+    return EVENT_NEVER;
+  uint64_t steps = 0;
+  for (;;) {
+    if ((frc >> 2) >= ocra)
+      return steps;
+    uint32_t n = (ocra * 4 - frc + 5) / 6;
+    if (frc + 6 * n <= 0xffff)
+      return steps + n;
+    // Counter wraps before it reaches the compare value
+    uint32_t w = (0x10000 - frc + 5) / 6;
+    frc = (frc + 6 * w) & 0xffff;
+    steps += w;
+  }
+}
 
-  {
-    bool matcha = (timer0_frc >> 2) >= timer0_ocra;
-    if (matcha)
-      timer0_frc = 0;
-    else
-      timer0_frc += 6;
+// Closed form of `steps` 12-cycle steps of one free-running timer.
+// Returns true if compare match A fired on any of them.
+static bool TIMER_FRT_Skip(uint16_t *frc, const uint16_t ocra,
+                           uint64_t steps) {
+  bool matched = false;
+  while (steps) {
+    uint64_t n = TIMER_FRT_StepsToMatch(*frc, ocra);
+    if (n >= steps) {
+      *frc = (uint16_t)(*frc + 6 * steps);
+      break;
+    }
+    *frc = 0;
+    matched = true;
+    steps -= n + 1;
+    steps %= TIMER_FRT_StepsToMatch(0, ocra) + 1;
+  }
+  return matched;
+}
 
-    if (matcha)
-      timer0_ocfa |= 0x20;
-    if (timer0_ociea && matcha)
+// Run the free-running timers over every 12-cycle step in
+// (from_cycles, to_cycles], raising OCIA for timers that matched. The
+// scheduler never lets an enabled compare match fall strictly inside the
+// range, so the request lands on the same step as clocking per instruction.
+void MCU::TIMER_Advance(const uint64_t from_cycles, const uint64_t to_cycles) {
+  if (to_cycles <= from_cycles)
+    return;
+  const uint64_t steps = (to_cycles - from_cycles) / 12;
+
+  if (TIMER_FRT_Skip(&timer0_frc, timer0_ocra, steps)) {
+    timer0_ocfa = true;
+    if (timer0_ociea)
       MCU_Interrupt_SetRequest(INTERRUPT_SOURCE_FRT0_OCIA, 1);
   }
-  {
-    bool matcha = (timer1_frc >> 2) >= timer1_ocra;
-    if (matcha)
-      timer1_frc = 0;
+  if (TIMER_FRT_Skip(&timer1_frc, timer1_ocra, steps)) {
+    timer1_ocfa = true;
+    if (timer1_ociea)
+      MCU_Interrupt_SetRequest(INTERRUPT_SOURCE_FRT1_OCIA, 1);
+  }
+  if (TIMER_FRT_Skip(&timer2_frc, timer2_ocra, steps)) {
+    timer2_ocfa = true;
+    if (timer2_ociea)
+      MCU_Interrupt_SetRequest(INTERRUPT_SOURCE_FRT2_OCIA, 1);
+  }
+}
+
+// Bring the free-running timers up to the current cycle. Called before the
+// core observes or changes timer state.
+void MCU::TIMER_Sync() {
+  TIMER_Advance(timer_cycles, mcu.cycles);
+  timer_cycles = mcu.cycles;
+}
+
+// Cycle of the next step on which a free-running timer requests an
+// interrupt. Only valid right after TIMER_Sync.
+uint64_t MCU::TIMER_NextInterrupt() {
+  uint64_t next = EVENT_NEVER;
+  uint64_t n;
+  if (timer0_ociea &&
+      (n = TIMER_FRT_StepsToMatch(timer0_frc, timer0_ocra)) != EVENT_NEVER)
+    next = std::min(next, timer_cycles + (n + 1) * 12);
+  if (timer1_ociea &&
+      (n = TIMER_FRT_StepsToMatch(timer1_frc, timer1_ocra)) != EVENT_NEVER)
+    next = std::min(next, timer_cycles + (n + 1) * 12);
+  if (timer2_ociea &&
+      (n = TIMER_FRT_StepsToMatch(timer2_frc, timer2_ocra)) != EVENT_NEVER)
+    next = std::min(next, timer_cycles + (n + 1) * 12);
+  return next;
+}
+
+void MCU::MCU_UpdateEvents() {
+  const uint64_t cycles = mcu.cycles;
+
+  if (event_deadline[EVENT_FRT] <= cycles) {
+    TIMER_Sync();
+    event_deadline[EVENT_FRT] = TIMER_NextInterrupt();
+  }
+
+  if (event_deadline[EVENT_TIMER8] <= cycles) {
+    TIMER8_Clock(cycles);
+    // Next step that lands on a 64-cycle boundary
+    event_deadline[EVENT_TIMER8] = EVENT_NEVER;
+    if (timer8_enabled) {
+      uint64_t next = cycles;
+      for (int i = 0; i < 16; i++) {
+        next += 12;
+        if ((next & 0x3f) == 0) {
+          event_deadline[EVENT_TIMER8] = next;
+          break;
+        }
+      }
+    }
+  }
+
+  if (event_deadline[EVENT_UART_RX] <= cycles) {
+    MCU_UpdateUART_RX();
+    if ((dev_register[DEV_SCR] & 16) != 0 && uart_write_ptr != uart_read_ptr &&
+        (dev_register[DEV_SSR] & 0x40) == 0)
+      event_deadline[EVENT_UART_RX] = uart_rx_delay;
     else
-      timer1_frc += 6;
+      event_deadline[EVENT_UART_RX] = EVENT_NEVER;
+  }
 
-    if (matcha)
-      timer1_ocfa |= 0x20;
-    if (timer1_ociea && matcha)
-      MCU_Interrupt_SetRequest(INTERRUPT_SOURCE_FRT1_OCIA, 1);
+  if (event_deadline[EVENT_UART_TX] <= cycles) {
+    MCU_UpdateUART_TX();
+    if ((dev_register[DEV_SCR] & 32) != 0 &&
+        (dev_register[DEV_SSR] & 0x80) == 0)
+      event_deadline[EVENT_UART_TX] = uart_tx_delay;
+    else
+      event_deadline[EVENT_UART_TX] = EVENT_NEVER;
   }
-  {
-    bool matcha = (timer2_frc >> 2) >= timer2_ocra;
-    if (matcha)
-      timer2_frc = 0;
+
+  if (event_deadline[EVENT_ANALOG] <= cycles) {
+    MCU_UpdateAnalog(cycles);
+    if (dev_register[DEV_ADCSR] & 0x20)
+      event_deadline[EVENT_ANALOG] = analog_end_time + 1;
     else
-      timer2_frc += 6;
+      event_deadline[EVENT_ANALOG] = EVENT_NEVER;
+  }
 
-    if (matcha)
-      timer2_ocfa |= 0x20;
-    if (timer2_ociea && matcha)
-      MCU_Interrupt_SetRequest(INTERRUPT_SOURCE_FRT2_OCIA, 1);
+  event_next = EVENT_NEVER;
+  for (int i = 0; i < EVENT_MAX; i++) {
+    if (event_deadline[i] < event_next)
+      event_next = event_deadline[i];
   }
 }
 
-MCU::MCU() : pcm(this), lcd(this) {}
+// The core is asleep or spinning on a branch to itself. Nothing changes
+// until an interrupt is taken, a peripheral event fires or the PCM renders
+// the next sample, so jump straight to the step before the earliest of
+// those.
+void MCU::MCU_FastForward() {
+  if (MCU_Interrupt_Deliverable())
+    return;
+
+  uint64_t deadline = std::min(event_next, pcm_sync_cycles + 1);
+  if (deadline <= mcu.cycles + 12)
+    return;
+
+  // Free-running timers catch up lazily on their next sync
+  uint64_t steps = (deadline - mcu.cycles - 1) / 12;
+  mcu.cycles += steps * 12;
+}
+
+// Pick the last MCU cycle the PCM may lag behind. With a voice IRQ
+// possible, every frame has to be rendered on time so the IRQ reaches the
+// MCU on the same step. Otherwise frames only matter for the sample count,
+// so the PCM can wait until the frame that completes updateSC55's block.
+void MCU::MCU_PCM_Schedule() {
+  const int frame_samples = pcm.PCM_FrameSamples();
+  int frames = (pcm_sample_target - sample_write_ptr + frame_samples - 1) /
+               frame_samples;
+  if (frames < 1)
+    frames = 1;
+
+  if (pcm.PCM_IrqPossible()) {
+    pcm_sync_cycles = pcm.pcm.cycles;
+    return;
+  }
+  pcm_sync_cycles = pcm.pcm.cycles +
+                    (frames - 1) * Pcm::PCM_FrameCycles(pcm.pcm.config_reg_3d);
+}
+
+void MCU::MCU_PCM_Begin(const int nSamples) {
+  sample_write_ptr = 0;
+  pcm_sample_target = nSamples;
+  MCU_PCM_Sync();
+}
+
+void MCU::MCU_PCM_End() { output_frame_samples = pcm.PCM_FrameSamples(); }
+
+void MCU::MCU_PCM_SetOutputMode(const int mode) { pcm.output_mode = mode; }
+
+void MCU::MCU_PCM_SetVoiceLimit(const int limit) { pcm.voice_limit = limit; }
+
+MCU::MCU() : pcm(this), lcd(this) { MCU_UpdateMemoryMap(); }
 
 int MCU::startSC55(const uint8_t *s_rom1, const uint8_t *s_rom2,
                    const uint8_t *s_waverom1, const uint8_t *s_waverom2,
@@ -778,8 +1034,11 @@ int MCU::startSC55(const uint8_t *s_rom1, const uint8_t *s_rom2,
 }
 
 void MCU::updateSC55(const int nSamples) {
-  sample_write_ptr = 0;
+  MCU_PCM_Begin(nSamples);
   while (sample_write_ptr < nSamples) {
+    if ((mcu.sleep || mcu.idle_loop) && !mcu.ex_ignore)
+      MCU_FastForward();
+
     if (!mcu.ex_ignore)
       MCU_Interrupt_Handle();
     else
@@ -790,13 +1049,13 @@ void MCU::updateSC55(const int nSamples) {
 
     mcu.cycles += 12; // FIXME: assume 12 cycles per instruction
 
-    TIMER_Clock(mcu.cycles);
-    MCU_UpdateUART_RX();
-    MCU_UpdateUART_TX();
-    MCU_UpdateAnalog(mcu.cycles);
+    if (mcu.cycles >= event_next)
+      MCU_UpdateEvents();
 
-    pcm.PCM_Update(mcu.cycles);
+    if (mcu.cycles > pcm_sync_cycles)
+      MCU_PCM_Sync();
   }
+  MCU_PCM_End();
 }
 
 void MCU::SC55_Reset() {
@@ -817,14 +1076,171 @@ void MCU::SC55_Reset() {
   uart_rx_delay = 0x00;
   uart_tx_delay = 0x00;
   memset(dev_register, 0, sizeof(dev_register));
+  MCU_UpdateMemoryMap();
+  MCU_WakeEvents();
 
   MCU_Init();
   MCU_PatchROM();
+  MCU_InvalidateDecodeCache();
   MCU_Reset();
   pcm.PCM_Reset();
   TIMER_Reset();
+  MCU_Interrupt_UpdateLevel();
+
+  sample_write_ptr = 0;
+  pcm_sync_cycles = 0;
+}
+
+void MCU::MCU_SaveState(mcu_state_t *state) {
+  TIMER_Sync();
+  MCU_PCM_Sync();
+
+  state->mcu = mcu;
+  memcpy(state->ram, ram, RAM_SIZE);
+  memcpy(state->sram, sram, SRAM_SIZE);
+  memcpy(state->nvram, nvram, NVRAM_SIZE);
+
+  state->mcu_button_pressed = mcu_button_pressed;
+  memcpy(state->ga_int, ga_int, sizeof(ga_int));
+  state->ga_int_enable = ga_int_enable;
+  state->ga_int_trigger = ga_int_trigger;
+  state->ga_lcd_counter = ga_lcd_counter;
+  memcpy(state->dev_register, dev_register, sizeof(dev_register));
+  state->io_sd = io_sd;
+  state->adf_rd = adf_rd;
+  state->analog_end_time = analog_end_time;
+  state->ssr_rd = ssr_rd;
+  state->midi_ready = midi_ready;
+
+  state->uart_write_ptr = uart_write_ptr;
+  state->uart_read_ptr = uart_read_ptr;
+  memcpy(state->uart_buffer, uart_buffer, uart_buffer_size);
+  state->uart_rx_byte = uart_rx_byte;
+  state->uart_rx_delay = uart_rx_delay;
+  state->uart_tx_delay = uart_tx_delay;
+
+  state->timer_tempreg = timer_tempreg;
+  state->timer8_enabled = timer8_enabled;
+  state->timer8_cmiea = timer8_cmiea;
+  state->timer8_cmfa = timer8_cmfa;
+  state->timer8_cmfa_read = timer8_cmfa_read;
+  state->timer8_tcora = timer8_tcora;
+  state->timer8_tcnt = timer8_tcnt;
+  state->timer_ocra[0] = timer0_ocra;
+  state->timer_ocra[1] = timer1_ocra;
+  state->timer_ocra[2] = timer2_ocra;
+  state->timer_frc[0] = timer0_frc;
+  state->timer_frc[1] = timer1_frc;
+  state->timer_frc[2] = timer2_frc;
+  state->timer_ocfa[0] = timer0_ocfa;
+  state->timer_ocfa[1] = timer1_ocfa;
+  state->timer_ocfa[2] = timer2_ocfa;
+  state->timer_ocfa_read[0] = timer0_ocfa_read;
+  state->timer_ocfa_read[1] = timer1_ocfa_read;
+  state->timer_ocfa_read[2] = timer2_ocfa_read;
+  state->timer_ociea[0] = timer0_ociea;
+  state->timer_ociea[1] = timer1_ociea;
+  state->timer_ociea[2] = timer2_ociea;
+  state->timer_cycles = timer_cycles;
+
+  state->pcm = pcm.pcm;
+
+  state->lcd_regs[0] = lcd.LCD_DL;
+  state->lcd_regs[1] = lcd.LCD_N;
+  state->lcd_regs[2] = lcd.LCD_F;
+  state->lcd_regs[3] = lcd.LCD_D;
+  state->lcd_regs[4] = lcd.LCD_C;
+  state->lcd_regs[5] = lcd.LCD_B;
+  state->lcd_regs[6] = lcd.LCD_ID;
+  state->lcd_regs[7] = lcd.LCD_S;
+  state->lcd_regs[8] = lcd.LCD_DD_RAM;
+  state->lcd_regs[9] = lcd.LCD_AC;
+  state->lcd_regs[10] = lcd.LCD_CG_RAM;
+  state->lcd_regs[11] = lcd.LCD_RAM_MODE;
+  memcpy(state->lcd_data, lcd.LCD_Data, sizeof(lcd.LCD_Data));
+  memcpy(state->lcd_cg, lcd.LCD_CG, sizeof(lcd.LCD_CG));
+  state->lcd_enable = lcd.lcd_enable;
+}
+
+// Counterpart of MCU_SaveState. Must run on the thread that calls
+// updateSC55. Derived state (memory map, scheduler, interrupt level) is
+// rebuilt rather than restored.
+void MCU::MCU_LoadState(const mcu_state_t *state) {
+  mcu = state->mcu;
+  memcpy(ram, state->ram, RAM_SIZE);
+  memcpy(sram, state->sram, SRAM_SIZE);
+  memcpy(nvram, state->nvram, NVRAM_SIZE);
+
+  mcu_button_pressed = state->mcu_button_pressed;
+  memcpy(ga_int, state->ga_int, sizeof(ga_int));
+  ga_int_enable = state->ga_int_enable;
+  ga_int_trigger = state->ga_int_trigger;
+  ga_lcd_counter = state->ga_lcd_counter;
+  memcpy(dev_register, state->dev_register, sizeof(dev_register));
+  io_sd = state->io_sd;
+  adf_rd = state->adf_rd;
+  analog_end_time = state->analog_end_time;
+  ssr_rd = state->ssr_rd;
+  midi_ready = state->midi_ready;
+
+  uart_write_ptr = state->uart_write_ptr;
+  uart_read_ptr = state->uart_read_ptr;
+  memcpy(uart_buffer, state->uart_buffer, uart_buffer_size);
+  uart_rx_byte = state->uart_rx_byte;
+  uart_rx_delay = state->uart_rx_delay;
+  uart_tx_delay = state->uart_tx_delay;
+
+  timer_tempreg = state->timer_tempreg;
+  timer8_enabled = state->timer8_enabled;
+  timer8_cmiea = state->timer8_cmiea;
+  timer8_cmfa = state->timer8_cmfa;
+  timer8_cmfa_read = state->timer8_cmfa_read;
+  timer8_tcora = state->timer8_tcora;
+  timer8_tcnt = state->timer8_tcnt;
+  timer0_ocra = state->timer_ocra[0];
+  timer1_ocra = state->timer_ocra[1];
+  timer2_ocra = state->timer_ocra[2];
+  timer0_frc = state->timer_frc[0];
+  timer1_frc = state->timer_frc[1];
+  timer2_frc = state->timer_frc[2];
+  timer0_ocfa = state->timer_ocfa[0];
+  timer1_ocfa = state->timer_ocfa[1];
+  timer2_ocfa = state->timer_ocfa[2];
+  timer0_ocfa_read = state->timer_ocfa_read[0];
+  timer1_ocfa_read = state->timer_ocfa_read[1];
+  timer2_ocfa_read = state->timer_ocfa_read[2];
+  timer0_ociea = state->timer_ociea[0];
+  timer1_ociea = state->timer_ociea[1];
+  timer2_ociea = state->timer_ociea[2];
+  timer_cycles = state->timer_cycles;
+
+  pcm.pcm = state->pcm;
+  pcm.PCM_ResetVoiceSteal();
+
+  lcd.LCD_DL = state->lcd_regs[0];
+  lcd.LCD_N = state->lcd_regs[1];
+  lcd.LCD_F = state->lcd_regs[2];
+  lcd.LCD_D = state->lcd_regs[3];
+  lcd.LCD_C = state->lcd_regs[4];
+  lcd.LCD_B = state->lcd_regs[5];
+  lcd.LCD_ID = state->lcd_regs[6];
+  lcd.LCD_S = state->lcd_regs[7];
+  lcd.LCD_DD_RAM = state->lcd_regs[8];
+  lcd.LCD_AC = state->lcd_regs[9];
+  lcd.LCD_CG_RAM = state->lcd_regs[10];
+  lcd.LCD_RAM_MODE = state->lcd_regs[11];
+  memcpy(lcd.LCD_Data, state->lcd_data, sizeof(lcd.LCD_Data));
+  memcpy(lcd.LCD_CG, state->lcd_cg, sizeof(lcd.LCD_CG));
+  lcd.lcd_enable = state->lcd_enable;
+
+  MCU_UpdateMemoryMap();
+  MCU_WakeEvents();
+  MCU_Interrupt_UpdateLevel();
+  pcm.PCM_UpdateIrqMask();
+  pcm.PCM_UpdateEramShadow();
 
   sample_write_ptr = 0;
+  pcm_sync_cycles = 0;
 }
 
 void MCU::postMidiSC55(const uint8_t *message, const int length) {
@@ -38,6 +38,7 @@
 #include "mcu_opcodes.h"
 #include "pcm.h"
 #include <stdint.h>
+#include <stdio.h>
 #include <vector>
 
 enum {
@@ -212,13 +213,29 @@ struct mcu_t {
   uint16_t sr;
   uint8_t cp, dp, ep, tp, br;
   uint8_t sleep;
+  uint8_t idle_loop; // last instruction was a branch to itself
   uint8_t ex_ignore;
   int32_t exception_pending;
   uint8_t interrupt_pending[INTERRUPT_SOURCE_MAX];
   uint8_t trapa_pending[16];
+  uint32_t interrupt_mask; // bit per set interrupt_pending entry
+  uint16_t trapa_mask;     // bit per set trapa_pending entry
   uint64_t cycles;
 };
 
+// General-operand instruction decoded once from ROM. ROM contents only
+// change in startSC55/MCU_PatchROM, so entries stay valid until the next
+// SC55_Reset.
+struct mcu_decode_t {
+  uint8_t length; // bytes up to and including the opcode, 0 = not decoded
+  uint8_t mode;   // effective address recipe
+  uint8_t opcode;
+  uint8_t opcode_extended;
+  uint16_t data; // displacement, absolute address or immediate
+};
+
+static const int MCU_DECODE_MAX_LENGTH = 5;
+
 enum {
   // JV880
   MCU_BUTTON_CURSOR_L = 0,
@@ -244,11 +261,80 @@ static const int ROM2_SIZE = 0x40000;
 static const int RAM_SIZE = 0x400;
 static const int SRAM_SIZE = 0x8000;
 static const int NVRAM_SIZE = 0x8000;   // JV880 only
+static const int NVRAM_MODE_OFFSET = 0x11; // JV880 only: 1 = patch, 0 = performance
 static const int CARDRAM_SIZE = 0x8000; // JV880 only
 static const int ROMSM_SIZE = 0x1000;
 const uint32_t uart_buffer_size = 8192;
+static const int DECODE_CACHE_SIZE = ROM1_SIZE + ROM2_SIZE;
+static const int MEMORY_MAP_SIZE = 0x1000; // 256-byte pages, 20-bit bus
 
 static const int audio_buffer_size = 4096;
+// sample_buffer holds the PCM's output words at full width, sign-extended
+static const int audio_sample_bits = 20;
+
+// Peripherals that are serviced from the event scheduler instead of after
+// every instruction. Each one records the cycle it next needs attention at.
+enum {
+  EVENT_FRT = 0,
+  EVENT_TIMER8,
+  EVENT_UART_RX,
+  EVENT_UART_TX,
+  EVENT_ANALOG,
+  EVENT_MAX
+};
+
+static const uint64_t EVENT_NEVER = UINT64_MAX;
+
+// Everything the running machine changes, for MCU_SaveState/MCU_LoadState.
+// ROMs, wave ROMs and cardram are left out: only the host writes those.
+// Plain data, so a snapshot can be copied or written to disk as-is.
+struct mcu_state_t {
+  mcu_t mcu;
+
+  uint8_t ram[RAM_SIZE];
+  uint8_t sram[SRAM_SIZE];
+  uint8_t nvram[NVRAM_SIZE];
+
+  uint32_t mcu_button_pressed;
+  int ga_int[8];
+  int ga_int_enable;
+  int ga_int_trigger;
+  int ga_lcd_counter;
+  uint8_t dev_register[0x80];
+  uint8_t io_sd;
+  int adf_rd;
+  uint64_t analog_end_time;
+  int ssr_rd;
+  bool midi_ready;
+
+  uint32_t uart_write_ptr;
+  uint32_t uart_read_ptr;
+  uint8_t uart_buffer[uart_buffer_size];
+  uint8_t uart_rx_byte;
+  uint64_t uart_rx_delay;
+  uint64_t uart_tx_delay;
+
+  uint8_t timer_tempreg;
+  bool timer8_enabled;
+  bool timer8_cmiea;
+  bool timer8_cmfa;
+  bool timer8_cmfa_read;
+  uint8_t timer8_tcora;
+  uint8_t timer8_tcnt;
+  uint16_t timer_ocra[3];
+  uint16_t timer_frc[3];
+  bool timer_ocfa[3];
+  bool timer_ocfa_read[3];
+  bool timer_ociea[3];
+  uint64_t timer_cycles;
+
+  pcm_t pcm;
+
+  uint32_t lcd_regs[12]; // DL N F D C B ID S DD_RAM AC CG_RAM RAM_MODE
+  uint8_t lcd_data[80];
+  uint8_t lcd_cg[64];
+  uint8_t lcd_enable;
+};
 
 struct MCU {
   uint32_t mcu_button_pressed;
@@ -271,6 +357,11 @@ struct MCU {
 
   uint8_t dev_register[0x80] = {0};
 
+  // Host pointers for pages that are plain memory, NULL for pages that need
+  // MCU_ReadIO/MCU_WriteIO. Rebuilt when DEV_RAME changes.
+  uint8_t *mem_read_map[MEMORY_MAP_SIZE];
+  uint8_t *mem_write_map[MEMORY_MAP_SIZE];
+
   uint8_t io_sd = 0x00;
 
   int adf_rd = 0;
@@ -287,6 +378,13 @@ struct MCU {
   uint64_t uart_rx_delay;
   uint64_t uart_tx_delay;
 
+  uint64_t event_deadline[EVENT_MAX];
+  uint64_t event_next;
+
+  // Highest priority level among pending interrupt sources, regardless of
+  // the sr mask. Kept current by MCU_Interrupt_UpdateLevel.
+  int32_t interrupt_level = 0;
+
   uint32_t operand_type;
   uint16_t operand_ea;
   uint8_t operand_ep;
@@ -296,6 +394,8 @@ struct MCU {
   uint16_t operand_data;
   uint8_t opcode_extended;
 
+  mcu_decode_t decode_cache[DECODE_CACHE_SIZE];
+
   uint8_t timer_tempreg;
 
   bool timer8_enabled;
@@ -320,13 +420,30 @@ struct MCU {
   bool timer0_ociea;
   bool timer1_ociea;
   bool timer2_ociea;
+  uint64_t timer_cycles; // step the free-running timers were advanced to
 
   Pcm pcm;
   LCD lcd;
 
-  int16_t sample_buffer[audio_buffer_size] = {0};
+  int32_t sample_buffer[audio_buffer_size] = {0};
   int sample_write_ptr = 0;
 
+  // The PCM is rendered lazily: it only has to catch up with the MCU when
+  // a PCM register is accessed, when a voice IRQ could be raised, or when
+  // updateSC55 has its samples. Until mcu.cycles passes pcm_sync_cycles
+  // none of those can happen.
+  uint64_t pcm_sync_cycles = 0;
+  int pcm_sample_target = 0;
+
+  // Values per PCM frame in sample_buffer (4 at 64 kHz, 2 at 32 kHz), as
+  // of the end of the block returned by updateSC55
+  int output_frame_samples = 4;
+
+  uint64_t instruction_count = 0; // for benchmarking, see tools/bench_core
+  // One line per interrupt/exception taken, for diffing timing between
+  // builds (bench_core --trace); null when off
+  FILE *interrupt_trace = nullptr;
+
   MCU();
 
   int startSC55(const uint8_t *s_rom1, const uint8_t *s_rom2,
@@ -335,13 +452,16 @@ struct MCU {
   void updateSC55(const int nSamples);
   void postMidiSC55(const uint8_t *message, int length);
   void SC55_Reset();
+  void MCU_SaveState(mcu_state_t *state);
+  void MCU_LoadState(const mcu_state_t *state);
   void MCU_PostUART(const uint8_t data);
   void MCU_EncoderTrigger(const int dir);
 
   void MCU_ErrorTrap();
 
-  uint8_t MCU_Read(uint32_t address);
-  void MCU_Write(uint32_t address, const uint8_t value);
+  uint8_t MCU_ReadIO(uint32_t address);
+  void MCU_WriteIO(uint32_t address, const uint8_t value);
+  void MCU_UpdateMemoryMap();
 
   void MCU_GA_SetGAInt(const int line, const int value);
   void MCU_UpdateUART_RX();
@@ -356,33 +476,71 @@ struct MCU {
   void MCU_Init();
   void MCU_Reset();
   void MCU_PatchROM();
+  void MCU_InvalidateDecodeCache();
 
   void MCU_Interrupt_Handle();
+  int32_t MCU_Interrupt_GetLevel(const uint32_t source, int32_t *vector);
+  bool MCU_Interrupt_Deliverable();
+  void MCU_Interrupt_UpdateLevel();
+  void MCU_FastForward();
+  void MCU_PCM_Schedule();
+  void MCU_PCM_Begin(const int nSamples);
+  void MCU_PCM_End();
+  void MCU_PCM_SetOutputMode(const int mode);
+  void MCU_PCM_SetVoiceLimit(const int limit);
+
+  void MCU_UpdateEvents();
 
   void TIMER_Reset();
   void TIMER_Write(const uint32_t address, const uint8_t data);
   uint8_t TIMER_Read(const uint32_t address);
-  void TIMER_Clock(const uint64_t cycles);
+  void TIMER_Advance(const uint64_t from_cycles, const uint64_t to_cycles);
+  void TIMER_Sync();
+  uint64_t TIMER_NextInterrupt();
+  void TIMER8_Clock(const uint64_t cycles);
 
   void TIMER2_Write(const uint32_t address, const uint8_t data);
   uint8_t TIMER_Read2(const uint32_t address);
 
   inline void MCU_PostSample(int *sample) {
-    /* Use int32 intermediate to detect overflow before casting to int16 */
-    int32_t l = sample[0] >> 16;
-    int32_t r = sample[1] >> 16;
-
-    /* Saturate to prevent wrap-around clipping on polyphonic passages */
-    if (l > 32767) l = 32767;
-    else if (l < -32768) l = -32768;
-    if (r > 32767) r = 32767;
-    else if (r < -32768) r = -32768;
-
-    sample_buffer[sample_write_ptr++] = (int16_t)l;
-    sample_buffer[sample_write_ptr++] = (int16_t)r;
+    /* The PCM leaves its (already clipped) 20-bit output word at the top
+     * of the int; keep all of it, the plugin converts to int16 once */
+    int32_t l = sample[0] >> (32 - audio_sample_bits);
+    int32_t r = sample[1] >> (32 - audio_sample_bits);
+
+    sample_buffer[sample_write_ptr++] = l;
+    sample_buffer[sample_write_ptr++] = r;
     sample_write_ptr %= audio_buffer_size;
   }
 
+  // Peripheral state changed outside the scheduler, re-evaluate the event
+  // on the next step.
+  inline void MCU_WakeEvent(const int event) {
+    event_deadline[event] = 0;
+    event_next = 0;
+  }
+
+  inline void MCU_WakeEvents() {
+    for (int i = 0; i < EVENT_MAX; i++)
+      event_deadline[i] = 0;
+    event_next = 0;
+  }
+
+  inline uint8_t MCU_Read(const uint32_t address) {
+    uint8_t *page = mem_read_map[(address >> 8) & (MEMORY_MAP_SIZE - 1)];
+    if (page)
+      return page[address & 0xff];
+    return MCU_ReadIO(address);
+  }
+
+  inline void MCU_Write(const uint32_t address, const uint8_t value) {
+    uint8_t *page = mem_write_map[(address >> 8) & (MEMORY_MAP_SIZE - 1)];
+    if (page)
+      page[address & 0xff] = value;
+    else
+      MCU_WriteIO(address, value);
+  }
+
   inline uint32_t MCU_GetAddress(const uint8_t page, const uint16_t address) {
     return (page << 16) | address;
   }
@@ -398,6 +556,17 @@ struct MCU {
     return ret;
   }
 
+  // Decode cache slot for the instruction starting at cp:pc, or NULL when
+  // the instruction may run past the end of rom1.
+  inline mcu_decode_t *MCU_GetDecodeEntry(const uint16_t pc) {
+    if (mcu.cp == 0) {
+      if (pc > ROM1_SIZE - MCU_DECODE_MAX_LENGTH)
+        return NULL;
+      return &decode_cache[pc];
+    }
+    return &decode_cache[ROM1_SIZE + (((mcu.cp << 16) | pc) & rom2_mask)];
+  }
+
   inline void MCU_SetRegisterByte(const uint8_t reg, const uint8_t val) {
     mcu.r[reg] = val;
   }
@@ -515,6 +684,9 @@ struct MCU {
 
   inline uint16_t MCU_Read16(uint32_t address) {
     address &= ~1;
+    uint8_t *page = mem_read_map[(address >> 8) & (MEMORY_MAP_SIZE - 1)];
+    if (page)
+      return (page[address & 0xff] << 8) + page[(address & 0xff) + 1];
     uint8_t b0, b1;
     b0 = MCU_Read(address);
     b1 = MCU_Read(address + 1);
@@ -523,6 +695,11 @@ struct MCU {
 
   inline uint32_t MCU_Read32(uint32_t address) {
     address &= ~3;
+    uint8_t *page = mem_read_map[(address >> 8) & (MEMORY_MAP_SIZE - 1)];
+    if (page) {
+      const uint8_t *p = &page[address & 0xff];
+      return (p[0] << 24) + (p[1] << 16) + (p[2] << 8) + p[3];
+    }
     uint8_t b0, b1, b2, b3;
     b0 = MCU_Read(address);
     b1 = MCU_Read(address + 1);
@@ -533,12 +710,19 @@ struct MCU {
 
   inline void MCU_Write16(uint32_t address, uint16_t value) {
     address &= ~1;
+    uint8_t *page = mem_write_map[(address >> 8) & (MEMORY_MAP_SIZE - 1)];
+    if (page) {
+      page[address & 0xff] = value >> 8;
+      page[(address & 0xff) + 1] = value & 0xff;
+      return;
+    }
     MCU_Write(address, value >> 8);
     MCU_Write(address + 1, value & 0xff);
   }
 
   inline void MCU_ReadInstruction() {
     uint8_t operand = MCU_ReadCodeAdvance();
+    instruction_count++;
 
     MCU_Operand_Table[operand](this, operand);
 
@@ -547,9 +731,23 @@ struct MCU {
     }
   }
 
+  // Render the PCM up to the MCU and pick the next sync point
+  inline void MCU_PCM_Sync() {
+    pcm.PCM_Update(mcu.cycles);
+    MCU_PCM_Schedule();
+  }
+
   inline void MCU_Interrupt_SetRequest(const uint32_t interrupt,
                                        const uint32_t value) {
-    mcu.interrupt_pending[interrupt] = value;
+    uint8_t pending = value;
+    if (mcu.interrupt_pending[interrupt] == pending)
+      return;
+    mcu.interrupt_pending[interrupt] = pending;
+    if (pending)
+      mcu.interrupt_mask |= 1u << interrupt;
+    else
+      mcu.interrupt_mask &= ~(1u << interrupt);
+    MCU_Interrupt_UpdateLevel();
   }
 
   inline void MCU_Interrupt_Exception(const uint32_t exception) {
@@ -558,11 +756,15 @@ struct MCU {
 
   inline void MCU_Interrupt_TRAPA(const uint32_t vector) {
     mcu.trapa_pending[vector] = 1;
+    mcu.trapa_mask |= 1u << vector;
   }
 
   inline void MCU_Interrupt_StartVector(const uint32_t vector,
                                         const int32_t mask) {
     uint32_t address = MCU_GetVectorAddress(vector);
+    if (interrupt_trace)
+      fprintf(interrupt_trace, "irq %llu vec=%u pc=%02x:%04x sr=%04x\n",
+              (unsigned long long)mcu.cycles, vector, mcu.cp, mcu.pc, mcu.sr);
     MCU_PushStack(mcu.pc);
     MCU_PushStack(mcu.cp);
     MCU_PushStack(mcu.sr);
@@ -572,6 +774,7 @@ struct MCU {
       mcu.sr |= mask << 8;
     }
     mcu.sleep = 0;
+    mcu.idle_loop = 0;
     mcu.cp = address >> 16;
     mcu.pc = address;
   }
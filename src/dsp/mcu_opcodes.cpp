@@ -161,12 +161,6 @@ enum {
     OPERAND_WORD
 };
 
-enum {
-    INCREASE_NONE = 0,
-    INCREASE_DECREASE,
-    INCREASE_INCREASE
-};
-
 void MCU_LDM(MCU *mcu, uint8_t operand)
 {
     uint8_t rlist = mcu->MCU_ReadCodeAdvance();
@@ -348,6 +342,8 @@ void MCU_Jump_Bcc(MCU *mcu, uint8_t operand)
     if (branch)
     {
         mcu->mcu.pc += disp;
+        // BRA to itself: only an interrupt can leave this loop
+        mcu->mcu.idle_loop = cond == 0x0 && disp == (uint16_t)((operand & 0x10) ? -3 : -2);
     }
 }
 
@@ -590,65 +586,56 @@ void MCU_Operand_Write(MCU *mcu, uint32_t data)
     }
 }
 
-void MCU_Operand_General(MCU *mcu, uint8_t operand)
+enum {
+    DECODE_DIRECT = 0,
+    DECODE_INDIRECT,
+    DECODE_PREDECREMENT,
+    DECODE_POSTINCREMENT,
+    DECODE_ABSOLUTE_SHORT,
+    DECODE_ABSOLUTE,
+    DECODE_IMMEDIATE
+};
+
+static void MCU_Operand_Decode(MCU *mcu, uint8_t operand, mcu_decode_t *dc)
 {
-    uint32_t type = GENERAL_DIRECT;
-    uint32_t disp = 0;
-    uint32_t increase = INCREASE_NONE;
-    uint32_t absolute = 0;
-    uint32_t reg = 0;
-    uint32_t siz = OPERAND_BYTE;
+    uint32_t reg = operand & 0x07;
+    uint32_t mode = DECODE_DIRECT;
     uint32_t data = 0;
-    uint32_t addr = 0;
-    uint32_t addrpage = 0;
-    uint32_t ea = 0;
-    uint32_t ep = 0;
-    uint8_t opcode;
-    uint8_t opcode_reg;
-    if (operand & 0x08)
-        siz = OPERAND_WORD;
-    else
-        siz = OPERAND_BYTE;
-    reg = operand & 0x07;
     switch (operand & 0xf0)
     {
     case 0xa0:
-        type = GENERAL_DIRECT;
+        mode = DECODE_DIRECT;
         break;
     case 0xd0:
-        type = GENERAL_INDIRECT;
+        mode = DECODE_INDIRECT;
         break;
     case 0xe0:
-        type = GENERAL_INDIRECT;
-        disp = (int8_t)mcu->MCU_ReadCodeAdvance();
+        mode = DECODE_INDIRECT;
+        data = (int8_t)mcu->MCU_ReadCodeAdvance();
         break;
     case 0xf0:
-        type = GENERAL_INDIRECT;
-        disp = mcu->MCU_ReadCodeAdvance();
-        disp <<= 8;
-        disp |= mcu->MCU_ReadCodeAdvance();
+        mode = DECODE_INDIRECT;
+        data = mcu->MCU_ReadCodeAdvance();
+        data <<= 8;
+        data |= mcu->MCU_ReadCodeAdvance();
         break;
     case 0xb0:
-        type = GENERAL_INDIRECT;
-        increase = INCREASE_DECREASE;
+        mode = DECODE_PREDECREMENT;
         break;
     case 0xc0:
-        type = GENERAL_INDIRECT;
-        increase = INCREASE_INCREASE;
+        mode = DECODE_POSTINCREMENT;
         break;
     case 0x00:
         if (reg == 5)
         {
-            type = GENERAL_ABSOLUTE;
-            addr = mcu->mcu.br << 8;
-            addr |= mcu->MCU_ReadCodeAdvance();
-            addrpage = 0;
+            mode = DECODE_ABSOLUTE_SHORT;
+            data = mcu->MCU_ReadCodeAdvance();
         }
         else if (reg == 4)
         {
-            type = GENERAL_IMMEDIATE;
+            mode = DECODE_IMMEDIATE;
             data = mcu->MCU_ReadCodeAdvance();
-            if (siz)
+            if (operand & 0x08)
             {
                 data <<= 8;
                 data |= mcu->MCU_ReadCodeAdvance();
@@ -658,58 +645,94 @@ void MCU_Operand_General(MCU *mcu, uint8_t operand)
     case 0x10:
         if (reg == 5)
         {
-            type = GENERAL_ABSOLUTE;
-            addr = mcu->MCU_ReadCodeAdvance() << 8;
-            addr |= mcu->MCU_ReadCodeAdvance();
-            addrpage = mcu->mcu.dp;
+            mode = DECODE_ABSOLUTE;
+            data = mcu->MCU_ReadCodeAdvance() << 8;
+            data |= mcu->MCU_ReadCodeAdvance();
         }
         break;
     }
-    if (type == GENERAL_INDIRECT)
+
+    uint8_t opcode = mcu->MCU_ReadCodeAdvance();
+    dc->opcode_extended = opcode == 0x00;
+    if (dc->opcode_extended)
     {
-        if (increase == INCREASE_DECREASE)
-        {
-            if (siz || reg == 7)
-            {
-                mcu->mcu.r[reg] -= 2;
-            }
-            else
-            {
-                mcu->mcu.r[reg] -= 1;
-            }
-        }
-        ea = mcu->mcu.r[reg] + disp;
-        if (increase == INCREASE_INCREASE)
-        {
-            if (siz || reg == 7)
-            {
-                mcu->mcu.r[reg] += 2;
-            }
-            else
-            {
-                mcu->mcu.r[reg] += 1;
-            }
-        }
+        opcode = mcu->MCU_ReadCodeAdvance();
+    }
+    dc->mode = mode;
+    dc->opcode = opcode;
+    dc->data = data;
+}
 
-        ea &= 0xffff;
+void MCU_Operand_General(MCU *mcu, uint8_t operand)
+{
+    uint32_t type = GENERAL_DIRECT;
+    uint32_t reg = operand & 0x07;
+    uint32_t siz = (operand & 0x08) ? OPERAND_WORD : OPERAND_BYTE;
+    uint32_t data = 0;
+    uint32_t ea = 0;
+    uint32_t ep = 0;
+    uint16_t start = mcu->mcu.pc - 1;
+    mcu_decode_t *dc = mcu->MCU_GetDecodeEntry(start);
+    mcu_decode_t uncached;
 
-        ep = mcu->MCU_GetPageForRegister(reg) & 0xff;
+    if (dc && dc->length)
+    {
+        mcu->mcu.pc = start + dc->length;
     }
-    else if (type == GENERAL_ABSOLUTE)
+    else
     {
-        ea = addr & 0xffff;
-
-        ep = addrpage & 0xff;
+        if (!dc)
+            dc = &uncached;
+        MCU_Operand_Decode(mcu, operand, dc);
+        dc->length = (uint16_t)(mcu->mcu.pc - start);
     }
 
-    opcode = mcu->MCU_ReadCodeAdvance();
-    mcu->opcode_extended = opcode == 0x00;
-    if (mcu->opcode_extended)
+    switch (dc->mode)
     {
-        opcode = mcu->MCU_ReadCodeAdvance();
+    case DECODE_DIRECT:
+        break;
+    case DECODE_INDIRECT:
+        type = GENERAL_INDIRECT;
+        ea = (mcu->mcu.r[reg] + dc->data) & 0xffff;
+        ep = mcu->MCU_GetPageForRegister(reg) & 0xff;
+        break;
+    case DECODE_PREDECREMENT:
+        type = GENERAL_INDIRECT;
+        if (siz || reg == 7)
+            mcu->mcu.r[reg] -= 2;
+        else
+            mcu->mcu.r[reg] -= 1;
+        ea = mcu->mcu.r[reg];
+        ep = mcu->MCU_GetPageForRegister(reg) & 0xff;
+        break;
+    case DECODE_POSTINCREMENT:
+        type = GENERAL_INDIRECT;
+        ea = mcu->mcu.r[reg];
+        if (siz || reg == 7)
+            mcu->mcu.r[reg] += 2;
+        else
+            mcu->mcu.r[reg] += 1;
+        ep = mcu->MCU_GetPageForRegister(reg) & 0xff;
+        break;
+    case DECODE_ABSOLUTE_SHORT:
+        type = GENERAL_ABSOLUTE;
+        ea = ((mcu->mcu.br << 8) | dc->data) & 0xffff;
+        break;
+    case DECODE_ABSOLUTE:
+        type = GENERAL_ABSOLUTE;
+        ea = dc->data;
+        ep = mcu->mcu.dp;
+        break;
+    case DECODE_IMMEDIATE:
+        type = GENERAL_IMMEDIATE;
+        data = dc->data;
+        break;
     }
-    opcode_reg = opcode & 0x07;
+
+    uint8_t opcode = dc->opcode;
+    uint8_t opcode_reg = opcode & 0x07;
     opcode >>= 3;
+    mcu->opcode_extended = dc->opcode_extended;
 
     mcu->operand_type = type;
     mcu->operand_ea = ea;
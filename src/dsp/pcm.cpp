@@ -37,7 +37,21 @@
 #include "mcu.h"
 #include "pcm.h"
 
-Pcm::Pcm(MCU *mcu): mcu(mcu) {}
+static uint8_t wave_zero_bank[Pcm::WAVE_BANK_SIZE];
+
+Pcm::Pcm(MCU *mcu): mcu(mcu)
+{
+    for (int i = 0; i < 8; i++)
+        wave_bank[i] = wave_zero_bank;
+    wave_bank[0] = waverom1;
+    wave_bank[1] = waverom2;
+    wave_bank[2] = waverom_card;
+}
+
+void Pcm::PCM_MapWaveBank(int bank, const uint8_t *data)
+{
+    wave_bank[bank & 7] = data ? data : wave_zero_bank;
+}
 
 void Pcm::PCM_Write(uint32_t address, uint8_t data)
 {
@@ -146,6 +160,14 @@ void Pcm::PCM_Write(uint32_t address, uint8_t data)
                 ix |= 8;
 
             pcm.ram2[pcm.select_channel][ix] = pcm.write_latch;
+
+            if (ix == 6)
+            {
+                if (pcm.write_latch & 1)
+                    irq_enable_mask |= 1u << pcm.select_channel;
+                else
+                    irq_enable_mask &= ~(1u << pcm.select_channel);
+            }
         }
     }
 }
@@ -228,6 +250,31 @@ uint8_t Pcm::PCM_Read(uint32_t address)
 void Pcm::PCM_Reset(void)
 {
     memset(&pcm, 0, sizeof(pcm));
+    irq_enable_mask = 0;
+    memset(&eram_shadow, 0, sizeof(eram_shadow));
+    meter.active_mask.store(0, std::memory_order_relaxed);
+    meter.active_peak.store(0, std::memory_order_relaxed);
+    for (int slot = 0; slot < 32; slot++)
+        meter.level[slot].store(0, std::memory_order_relaxed);
+    meter.out_peak.store(0, std::memory_order_relaxed);
+    PCM_ResetVoiceSteal();
+}
+
+// Also on a state load: onsets are on the old pcm.cycles timeline
+void Pcm::PCM_ResetVoiceSteal(void)
+{
+    voice_stolen.store(0, std::memory_order_relaxed);
+    memset(voice_onset, 0, sizeof(voice_onset));
+}
+
+void Pcm::PCM_UpdateIrqMask(void)
+{
+    irq_enable_mask = 0;
+    for (int slot = 0; slot < 32; slot++)
+    {
+        if (pcm.ram2[slot][6] & 1)
+            irq_enable_mask |= 1u << slot;
+    }
 }
 
 // Sign-extends a 20-bit signed integer to a 32-bit signed integer.
@@ -387,18 +434,22 @@ inline void calc_tv(pcm_t *pcm, int e, int adjust, uint16_t *levelcur, int activ
     }
 }
 
-inline int eram_unpack(pcm_t *pcm, int addr, int type = 0)
+inline int32_t eram_decode(int data)
 {
-    addr &= 0x3fff;
-    int data = pcm->eram[addr];
     int val = data & 0x3fff;
     int sh = (data >> 14) & 3;
 
     val <<= 18;
-    return val >> (18 - sh * 2 + type);
+    return val >> (18 - sh * 2);
+}
+
+// type 1 taps read the decoded value halved
+inline int eram_unpack(const pcm_eram_shadow_t *shadow, int addr, int type = 0)
+{
+    return shadow->dec[addr & 0x3fff] >> type;
 }
 
-inline void eram_pack(pcm_t *pcm, int addr, int val)
+inline void eram_pack(pcm_t *pcm, pcm_eram_shadow_t *shadow, int addr, int val)
 {
     addr &= 0x3fff;
     int sh = 0;
@@ -416,621 +467,720 @@ inline void eram_pack(pcm_t *pcm, int addr, int val)
 
     int data = (val >> (sh * 2)) & 0x3fff;
     data |= sh << 14;
+    shadow->nonzero += (data != 0) - (pcm->eram[addr] != 0);
+    shadow->dec[addr] = eram_decode(data);
     pcm->eram[addr] = data;
 }
 
-void Pcm::PCM_Update(uint64_t cycles)
+void Pcm::PCM_UpdateEramShadow(void)
 {
-    int reg_slots = (pcm.config_reg_3d & 31) + 1;
-    int voice_active = pcm.voice_mask & pcm.voice_mask_pending;
-    while (pcm.cycles < cycles)
+    eram_shadow.nonzero = 0;
+    for (int i = 0; i < 0x4000; i++)
     {
-        int tt[2] = {};
+        eram_shadow.dec[i] = eram_decode(pcm.eram[i]);
+        eram_shadow.nonzero += pcm.eram[i] != 0;
+    }
+}
 
-        { // final mixing
-            int noise_mask = 0;
-            int orval = 0;
-            int write_mask = 3;
-            // int dac_mask = -4;
+// Vector forms of sx20/multi/addclip20 for the voice back end, four slots
+// per vector (one NEON/SSE register). Lane results match the scalar
+// helpers bit for bit.
+typedef int32_t pcm_v4i __attribute__((vector_size(16)));
+typedef uint32_t pcm_v4u __attribute__((vector_size(16)));
 
+static inline pcm_v4i v_load(const int32_t *p)
+{
+    pcm_v4i v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
 
-            int shifter = pcm.ram2[30][10];
-            int xr = ((shifter >> 0) ^ (shifter >> 1) ^ (shifter >> 7) ^ (shifter >> 12)) & 1;
-            shifter = (shifter >> 1) | (xr << 15);
-            pcm.ram2[30][10] = shifter;
+static inline void v_store(int32_t *p, pcm_v4i v)
+{
+    memcpy(p, &v, sizeof(v));
+}
 
-            pcm.accum_l = addclip20(pcm.accum_l, pcm.ram1[30][0], 0);
-            pcm.accum_r = addclip20(pcm.accum_r, pcm.ram1[30][1], 0);
+static inline pcm_v4i v_sx20(pcm_v4i in)
+{
+    return (pcm_v4i)((pcm_v4u)in << 12) >> 12;
+}
 
-            pcm.ram1[30][2] = addclip20(pcm.accum_l,
-                orval | (shifter & noise_mask), 0);
+static inline pcm_v4i v_sx8(pcm_v4i in)
+{
+    return (pcm_v4i)((pcm_v4u)in << 24) >> 24;
+}
 
-            pcm.ram1[30][4] = addclip20(pcm.accum_r,
-                orval | (shifter & noise_mask), 0);
+static inline pcm_v4i v_mul(pcm_v4i a, pcm_v4i b)
+{
+    return (pcm_v4i)((pcm_v4u)a * (pcm_v4u)b);
+}
 
-            pcm.ram1[30][0] = pcm.accum_l & write_mask;
-            pcm.ram1[30][1] = pcm.accum_r & write_mask;
-            
+static inline pcm_v4i v_multi(pcm_v4i val1, pcm_v4i val2)
+{
+    return v_mul(v_sx20(val1), v_sx8(val2));
+}
 
-            tt[0] = (int)((pcm.ram1[30][2] & ~write_mask) << 12);
-            tt[1] = (int)((pcm.ram1[30][4] & ~write_mask) << 12);
+static inline pcm_v4i v_addclip20(pcm_v4i add1, pcm_v4i add2, pcm_v4i cin)
+{
+    pcm_v4u a = (pcm_v4u)add1;
+    pcm_v4u b = (pcm_v4u)add2;
+    pcm_v4u sum = (a + b + (pcm_v4u)cin) & 0xfffff;
+    pcm_v4i neg_a = (a & 0x80000) != 0;
+    pcm_v4i neg_b = (b & 0x80000) != 0;
+    pcm_v4i neg_s = (sum & 0x80000) != 0;
+    pcm_v4i clip_lo = neg_a & neg_b & ~neg_s;
+    pcm_v4i clip_hi = ~neg_a & ~neg_b & neg_s;
+    pcm_v4i r = (pcm_v4i)sum & ~(clip_lo | clip_hi);
+    return r | (clip_lo & 0x80000) | (clip_hi & 0x7ffff);
+}
 
-            mcu->MCU_PostSample(tt);
+// x + (x >> n) rounding used by the filter and volume stages
+static inline pcm_v4i v_round_shift(pcm_v4i x, int n)
+{
+    return (x >> n) + ((x >> (n - 1)) & 1);
+}
 
-            xr = ((shifter >> 0) ^ (shifter >> 1) ^ (shifter >> 7) ^ (shifter >> 12)) & 1;
-            shifter = (shifter >> 1) | (xr << 15);
+// Filter, volume and pan/send multiplies for slots [first, last). Pure
+// arithmetic on the lanes; state write-back and mixing stay in slot order
+// in PCM_Update.
+static void PCM_VoiceBackEnd(pcm_voice_lanes_t *l, int first, int last)
+{
+    for (int i = first; i < last; i += 4)
+    {
+        pcm_v4i reg1 = v_load(&l->reg1[i]);
+        pcm_v4i reg3 = v_load(&l->reg3[i]);
+        pcm_v4i filter = v_load(&l->filter[i]);
+        pcm_v4i cut_hi = v_sx8(filter >> 8);
+        pcm_v4i cut_lo = (filter >> 1) & 127;
+
+        // hack: use 32-bit math to avoid overflow
+        pcm_v4i mult1 = v_mul(reg1, cut_hi); // 8
+        pcm_v4i mult2 = v_mul(reg1, cut_lo); // 9
+        pcm_v4i mult3 = v_mul(reg1, v_load(&l->reg2_6[i])); // 10
+
+        pcm_v4i v2 = reg3 + v_round_shift(mult1, 6); // 9
+        pcm_v4i v1 = v2 + v_round_shift(mult2, 13); // 10
+        pcm_v4i subvar = v1 + v_round_shift(mult3, 6); // 11
+
+        pcm_v4i v3 = v_sx20(v_load(&l->test[i])) - subvar; // 12
+
+        pcm_v4i mult4 = v_mul(v3, cut_hi);
+        pcm_v4i mult5 = v_mul(v3, cut_lo);
+        pcm_v4i v4 = reg1 + v_round_shift(mult4, 6); // 14
+        pcm_v4i v5 = v4 + v_round_shift(mult5, 13); // 15
+
+        v_store(&l->v1[i], v1);
+        v_store(&l->v5[i], v5);
+
+        pcm_v4i use_v3 = v_load(&l->use_v3[i]);
+        pcm_v4i sample = (v3 & use_v3) | (v1 & ~use_v3);
+
+        pcm_v4i volmul1 = v_load(&l->volmul1[i]);
+        pcm_v4i multiv1 = v_multi(sample, volmul1 >> 8);
+        pcm_v4i multiv2 = v_multi(sample, (volmul1 >> 1) & 127);
+        pcm_v4i sample2 = v_addclip20(multiv1 >> 6, multiv2 >> 13, ((multiv2 >> 12) | (multiv1 >> 5)) & 1);
+
+        pcm_v4i volmul2 = v_load(&l->volmul2[i]);
+        pcm_v4i multiv3 = v_multi(sample2, volmul2 >> 8);
+        pcm_v4i multiv4 = v_multi(sample2, (volmul2 >> 1) & 127);
+        pcm_v4i sample3 = v_addclip20(multiv3 >> 6, multiv4 >> 13, ((multiv4 >> 12) | (multiv3 >> 5)) & 1);
+
+        pcm_v4i pan = v_load(&l->pan[i]);
+        pcm_v4i rc = v_load(&l->rc[i]);
+        v_store(&l->sampl[i], v_multi(sample3, (pan >> 8) & 255));
+        v_store(&l->sampr[i], v_multi(sample3, pan & 255));
+        v_store(&l->rc0[i], v_multi(sample3, (rc >> 8) & 255) >> 5); // reverb
+        v_store(&l->rc1[i], v_multi(sample3, rc & 255) >> 5); // chorus
+    }
+}
 
-            pcm.accum_l = addclip20(pcm.accum_l, pcm.ram1[30][0], 0);
-            pcm.accum_r = addclip20(pcm.accum_r, pcm.ram1[30][1], 0);
+// Reverb and chorus: feeds the sends summed in the previous frame (rcsum)
+// through the delay network in eram and returns what the mix adds back at
+// slots 17-23 and 31.
+void Pcm::PCM_ReverbChorus(int *rcadd, int *rcadd2)
+{
+    {
+        int v1 = pcm.ram2[31][1];
 
-            pcm.ram1[30][3] = addclip20(pcm.accum_l,
-                orval | (shifter & noise_mask), 0);
+        int m1 = multi(pcm.ram1[29][1], v1 >> 8) >> 5; // 14
+        int m2 = multi(pcm.rcsum[1], v1 & 255) >> 5; // 15
 
-            pcm.ram1[30][5] = addclip20(pcm.accum_r,
-                orval | (shifter & noise_mask), 0);
+        pcm.ram1[29][1] = addclip20(m1 >> 1, m2 >> 1, (m1 | m2) & 1); // 16
+    }
 
-            // if (pcm.config_reg_3c & 0x40) // oversampling
-            if (true) // oversampling enabled - 64kHz output rate
-            {
-                pcm.ram2[30][10] = shifter;
+    {
+        int v1 = pcm.ram2[30][1];
+        int m1 = multi(pcm.ram1[29][0], v1 >> 8) >> 5; // 17
+        int m2 = multi(pcm.rcsum[0], v1 & 255) >> 5; // 18
 
-                pcm.ram1[30][0] = pcm.accum_l & write_mask;
-                pcm.ram1[30][1] = pcm.accum_r & write_mask;
+        pcm.ram1[29][0] = addclip20(m1 >> 1, m2 >> 1, (m1 | m2) & 1); // 19
+    }
 
+    {
+        // 1
+        int v1 = pcm.ram2[30][4];
+        int m1 = multi(pcm.ram1[29][0], (v1 >> 8)) >> 6;
+        int v2 = 0;
+        int s1 = eram_unpack(&eram_shadow, pcm.ram2[28][1] + pcm.tv_counter, 1);
+        int s2 = eram_unpack(&eram_shadow, pcm.ram2[28][1] + pcm.tv_counter);
+        if ((v1 & 0x30) != 0)
+        {
+            v2 = s1;
+        }
+        int v3 = addclip20(m1, v2 ^ 0xfffff, 1);
+        pcm.ram1[29][4] = v3;
+        int m2 = multi(v3, v1 & 255) >> 5;
+        pcm.ram1[29][5] = addclip20(m2 >> 1, s2, m2 & 1);
+    }
+    {
+        // 2
+        int v1 = pcm.ram2[30][4];
+        int v2 = 0;
+        int s1 = eram_unpack(&eram_shadow, pcm.ram2[28][2] + pcm.tv_counter, 1);
+        int s2 = eram_unpack(&eram_shadow, pcm.ram2[28][2] + pcm.tv_counter);
+        if ((v1 & 0x30) != 0)
+        {
+            v2 = s1;
+        }
+        int v3 = addclip20(pcm.ram1[29][5], v2 ^ 0xfffff, 1);
+        pcm.ram1[29][5] = v3;
+        int m2 = multi(v3, v1 & 255) >> 5;
+        pcm.ram1[28][0] = addclip20(m2 >> 1, s2, m2 & 1);
+    }
+    {
+        // 3
+        int v1 = pcm.ram2[30][4];
+        int v2 = 0;
+        int s1 = eram_unpack(&eram_shadow, pcm.ram2[28][3] + pcm.tv_counter, 1);
+        int s2 = eram_unpack(&eram_shadow, pcm.ram2[28][3] + pcm.tv_counter);
+        if ((v1 & 0x30) != 0)
+        {
+            v2 = s1;
+        }
+        int v3 = addclip20(pcm.ram1[28][0], v2 ^ 0xfffff, 1);
+        pcm.ram1[28][0] = v3;
+        int m2 = multi(v3, v1 & 255) >> 5;
+        pcm.ram1[28][1] = addclip20(m2 >> 1, s2, m2 & 1);
 
-                tt[0] = (int)((pcm.ram1[30][3] & ~write_mask) << 12);
-                tt[1] = (int)((pcm.ram1[30][5] & ~write_mask) << 12);
 
-                mcu->MCU_PostSample(tt);
-            }
+        pcm.ram1[28][2] = eram_unpack(&eram_shadow, pcm.ram2[28][5] + pcm.tv_counter);
+    }
+    {
+        // 4
+        int v1 = pcm.ram2[30][5];
+        int v2 = 0;
+        int s1 = eram_unpack(&eram_shadow, pcm.ram2[28][4] + pcm.tv_counter, 1);
+        int s2 = eram_unpack(&eram_shadow, pcm.ram2[28][4] + pcm.tv_counter);
+        if ((v1 & 0x30) != 0)
+        {
+            v2 = s1;
         }
+        int v3 = addclip20(pcm.ram1[28][1], v2 ^ 0xfffff, 1);
+        pcm.ram1[28][1] = v3;
+        int m2 = multi(v3, v1 & 255) >> 5;
+        pcm.ram1[28][3] = addclip20(m2 >> 1, s2, m2 & 1);
 
-        { // global counter for envelopes
-            if (!pcm.nfs)
-                pcm.tv_counter = pcm.ram2[31][8]; // fixme
 
-            pcm.tv_counter -= 1;
+        pcm.ram1[28][4] = eram_unpack(&eram_shadow, pcm.ram2[29][1] + pcm.tv_counter);
+    }
+    {
+        // 5
 
-            pcm.tv_counter &= 0x3fff;
-        }
+        int v1 = pcm.ram2[30][7];
+        int m1 = multi(pcm.ram1[29][2], (v1 >> 8)) >> 5;
+        int s1 = eram_unpack(&eram_shadow, pcm.ram2[29][0] + pcm.tv_counter);
+        int m2 = multi(s1, v1 & 255) >> 5;
+        pcm.ram1[29][2] = addclip20(m1 >> 1, m2 >> 1, (m1 | m2) & 1);
 
-        // chorus/reverb
+        eram_pack(&pcm, &eram_shadow, pcm.ram2[28][0] + pcm.tv_counter, pcm.ram1[29][4]);
+    }
+    {
+        // 6
 
-        { // fixme
-            if (pcm.ram2[31][8] & 0x8000)
-                pcm.ram2[31][9] = pcm.ram2[31][8] & 0x7fff;
-            else
-                pcm.ram2[31][10] = pcm.ram2[31][8] & 0x7fff;
+        int v1 = pcm.ram2[30][8];
+        int m1 = multi(pcm.ram1[29][3], (v1 >> 8)) >> 5;
+        int s1 = eram_unpack(&eram_shadow, pcm.ram2[29][8] + pcm.tv_counter);
+        int m2 = multi(s1, v1 & 255) >> 5;
+        pcm.ram1[29][3] = addclip20(m1 >> 1, m2 >> 1, (m1 | m2) & 1);
 
-            if ((0x4000 - pcm.ram2[31][8]) & 0x8000)
-                pcm.ram2[31][10] = (0x4000 - pcm.ram2[31][8]) & 0x7fff;
-            else
-                pcm.ram2[31][9] = (0x4000 - pcm.ram2[31][8]) & 0x7fff;
-        }
+        eram_pack(&pcm, &eram_shadow, pcm.ram2[28][1] + pcm.tv_counter, pcm.ram1[29][5]);
 
-        {
-            int v1 = pcm.ram2[31][1];
+        eram_pack(&pcm, &eram_shadow, pcm.ram2[28][2] + pcm.tv_counter, pcm.ram1[28][0]);
+    }
+    {
+        // 7
 
-            int m1 = multi(pcm.ram1[29][1], v1 >> 8) >> 5; // 14
-            int m2 = multi(pcm.rcsum[1], v1 & 255) >> 5; // 15
+        int v1 = pcm.ram2[30][9];
+        int v2 = pcm.ram1[28][3];
+        int m1 = multi(pcm.ram1[29][2], (v1 >> 8)) >> 5;
+        int m2 = multi(pcm.ram1[29][3], (v1 >> 8)) >> 5;
+        pcm.ram1[28][3] = addclip20(v2, m1 >> 1, m1 & 1);
+        pcm.ram1[28][5] = addclip20(v2, m2 >> 1, m2 & 1);
 
-            pcm.ram1[29][1] = addclip20(m1 >> 1, m2 >> 1, (m1 | m2) & 1); // 16
-        }
+        eram_pack(&pcm, &eram_shadow, pcm.ram2[28][3] + pcm.tv_counter, pcm.ram1[28][1]);
+    }
+    {
+        // 8
 
-        {
-            int okey = (pcm.ram2[31][7] & 0x20) != 0;
-            int key = 1;
-            int active = okey && key;
-            int u = 0;
-            calc_tv(&pcm, 1, pcm.ram2[30][0], &pcm.ram2[30][9], active, &u);
-        }
+        int v1 = pcm.ram2[30][6];
+        int m1 = multi(pcm.ram1[28][2], v1 >> 8) >> 5;
 
-        {
-            int v1 = pcm.ram2[30][1];
-            int m1 = multi(pcm.ram1[29][0], v1 >> 8) >> 5; // 17
-            int m2 = multi(pcm.rcsum[0], v1 & 255) >> 5; // 18
+        int v2 = addclip20(pcm.ram1[28][3], m1 >> 1, m1 & 1);
+        pcm.ram1[28][3] = v2;
+        int m2 = multi(v2, v1 & 255) >> 5;
+        pcm.ram1[28][2] = addclip20(pcm.ram1[28][2], m2 >> 1, m2 & 1);
 
-            pcm.ram1[29][0] = addclip20(m1 >> 1, m2 >> 1, (m1 | m2) & 1); // 19
-        }
 
-        int rcadd[6] = {};
-        int rcadd2[6] = {};
+        pcm.ram1[28][1] = eram_unpack(&eram_shadow, pcm.ram2[28][9] + pcm.tv_counter);
+    }
+    {
+        // 9
 
-        {
-            {
-                // 1
-                int v1 = pcm.ram2[30][4];
-                int m1 = multi(pcm.ram1[29][0], (v1 >> 8)) >> 6;
-                int v2 = 0;
-                int s1 = eram_unpack(&pcm, pcm.ram2[28][1] + pcm.tv_counter, 1);
-                int s2 = eram_unpack(&pcm, pcm.ram2[28][1] + pcm.tv_counter);
-                if ((v1 & 0x30) != 0)
-                {
-                    v2 = s1;
-                }
-                int v3 = addclip20(m1, v2 ^ 0xfffff, 1);
-                pcm.ram1[29][4] = v3;
-                int m2 = multi(v3, v1 & 255) >> 5;
-                pcm.ram1[29][5] = addclip20(m2 >> 1, s2, m2 & 1);
-            }
-            {
-                // 2
-                int v1 = pcm.ram2[30][4];
-                int v2 = 0;
-                int s1 = eram_unpack(&pcm, pcm.ram2[28][2] + pcm.tv_counter, 1);
-                int s2 = eram_unpack(&pcm, pcm.ram2[28][2] + pcm.tv_counter);
-                if ((v1 & 0x30) != 0)
-                {
-                    v2 = s1;
-                }
-                int v3 = addclip20(pcm.ram1[29][5], v2 ^ 0xfffff, 1);
-                pcm.ram1[29][5] = v3;
-                int m2 = multi(v3, v1 & 255) >> 5;
-                pcm.ram1[28][0] = addclip20(m2 >> 1, s2, m2 & 1);
-            }
-            {
-                // 3
-                int v1 = pcm.ram2[30][4];
-                int v2 = 0;
-                int s1 = eram_unpack(&pcm, pcm.ram2[28][3] + pcm.tv_counter, 1);
-                int s2 = eram_unpack(&pcm, pcm.ram2[28][3] + pcm.tv_counter);
-                if ((v1 & 0x30) != 0)
-                {
-                    v2 = s1;
-                }
-                int v3 = addclip20(pcm.ram1[28][0], v2 ^ 0xfffff, 1);
-                pcm.ram1[28][0] = v3;
-                int m2 = multi(v3, v1 & 255) >> 5;
-                pcm.ram1[28][1] = addclip20(m2 >> 1, s2, m2 & 1);
+        int v1 = pcm.ram2[30][6];
+        int m1 = multi(pcm.ram1[28][4], v1 >> 8) >> 5;
 
+        int v2 = addclip20(pcm.ram1[28][5], m1 >> 1, m1 & 1);
+        pcm.ram1[28][5] = v2;
+        int m2 = multi(v2, v1 & 255) >> 5;
+        pcm.ram1[28][4] = addclip20(pcm.ram1[28][4], m2 >> 1, m2 & 1);
 
-                pcm.ram1[28][2] = eram_unpack(&pcm, pcm.ram2[28][5] + pcm.tv_counter);
-            }
-            {
-                // 4
-                int v1 = pcm.ram2[30][5];
-                int v2 = 0;
-                int s1 = eram_unpack(&pcm, pcm.ram2[28][4] + pcm.tv_counter, 1);
-                int s2 = eram_unpack(&pcm, pcm.ram2[28][4] + pcm.tv_counter);
-                if ((v1 & 0x30) != 0)
-                {
-                    v2 = s1;
-                }
-                int v3 = addclip20(pcm.ram1[28][1], v2 ^ 0xfffff, 1);
-                pcm.ram1[28][1] = v3;
-                int m2 = multi(v3, v1 & 255) >> 5;
-                pcm.ram1[28][3] = addclip20(m2 >> 1, s2, m2 & 1);
 
+        pcm.ram1[29][4] = eram_unpack(&eram_shadow, pcm.ram2[29][5] + pcm.tv_counter);
+    }
+    {
+        // 10
+
+        int v1 = pcm.ram2[30][6];
+        int v2 = pcm.ram1[28][1];
+        int m1 = multi(v2, v1 >> 8) >> 5;
+        int s1 = eram_unpack(&eram_shadow, pcm.ram2[28][8] + pcm.tv_counter);
+        int v3 = addclip20(m1 >> 1, s1, m1 & 1);
+        pcm.ram1[28][1] = v3;
+        int m2 = multi(v3, v1 & 255) >> 5;
+        pcm.ram1[29][5] = addclip20(m2 >> 1, v2, m2 & 1);
+
+        eram_pack(&pcm, &eram_shadow, pcm.ram2[28][4] + pcm.tv_counter, pcm.ram1[28][3]);
+    }
+    {
+        // 11
 
-                pcm.ram1[28][4] = eram_unpack(&pcm, pcm.ram2[29][1] + pcm.tv_counter);
-            }
-            {
-                // 5
+        int v1 = pcm.ram2[30][6];
+        int v2 = pcm.ram1[29][4];
+        int m1 = multi(v2, v1 >> 8) >> 5;
+        int s1 = eram_unpack(&eram_shadow, pcm.ram2[29][4] + pcm.tv_counter);
+        int v3 = addclip20(m1 >> 1, s1, m1 & 1);
+        pcm.ram1[29][4] = v3;
+        int m2 = multi(v3, v1 & 255) >> 5;
+        pcm.ram1[28][0] = addclip20(m2 >> 1, v2, m2 & 1);
 
-                int v1 = pcm.ram2[30][7];
-                int m1 = multi(pcm.ram1[29][2], (v1 >> 8)) >> 5;
-                int s1 = eram_unpack(&pcm, pcm.ram2[29][0] + pcm.tv_counter);
-                int m2 = multi(s1, v1 & 255) >> 5;
-                pcm.ram1[29][2] = addclip20(m1 >> 1, m2 >> 1, (m1 | m2) & 1);
 
-                eram_pack(&pcm, pcm.ram2[28][0] + pcm.tv_counter, pcm.ram1[29][4]);
-            }
-            {
-                // 6
+        eram_pack(&pcm, &eram_shadow, pcm.ram2[28][5] + pcm.tv_counter, pcm.ram1[28][2]);
 
-                int v1 = pcm.ram2[30][8];
-                int m1 = multi(pcm.ram1[29][3], (v1 >> 8)) >> 5;
-                int s1 = eram_unpack(&pcm, pcm.ram2[29][8] + pcm.tv_counter);
-                int m2 = multi(s1, v1 & 255) >> 5;
-                pcm.ram1[29][3] = addclip20(m1 >> 1, m2 >> 1, (m1 | m2) & 1);
+        eram_pack(&pcm, &eram_shadow, pcm.ram2[29][0] + pcm.tv_counter, pcm.ram1[28][5]);
+    }
+    {
+        // 12
 
-                eram_pack(&pcm, pcm.ram2[28][1] + pcm.tv_counter, pcm.ram1[29][5]);
+        pcm.ram1[28][5] = eram_unpack(&eram_shadow, pcm.ram2[28][6] + pcm.tv_counter);
+    }
 
-                eram_pack(&pcm, pcm.ram2[28][2] + pcm.tv_counter, pcm.ram1[28][0]);
-            }
-            {
-                // 7
+    {
+        // 13
 
-                int v1 = pcm.ram2[30][9];
-                int v2 = pcm.ram1[28][3];
-                int m1 = multi(pcm.ram1[29][2], (v1 >> 8)) >> 5;
-                int m2 = multi(pcm.ram1[29][3], (v1 >> 8)) >> 5;
-                pcm.ram1[28][3] = addclip20(v2, m1 >> 1, m1 & 1);
-                pcm.ram1[28][5] = addclip20(v2, m2 >> 1, m2 & 1);
+        int s1 = eram_unpack(&eram_shadow, pcm.ram2[28][10] + pcm.tv_counter);
+        pcm.ram1[28][5] = addclip20(pcm.ram1[28][5], s1, 0);
 
-                eram_pack(&pcm, pcm.ram2[28][3] + pcm.tv_counter, pcm.ram1[28][1]);
-            }
-            {
-                // 8
+        pcm.ram1[28][2] = eram_unpack(&eram_shadow, pcm.ram2[29][2] + pcm.tv_counter);
+    }
 
-                int v1 = pcm.ram2[30][6];
-                int m1 = multi(pcm.ram1[28][2], v1 >> 8) >> 5;
+    {
+        // 14
 
-                int v2 = addclip20(pcm.ram1[28][3], m1 >> 1, m1 & 1);
-                pcm.ram1[28][3] = v2;
-                int m2 = multi(v2, v1 & 255) >> 5;
-                pcm.ram1[28][2] = addclip20(pcm.ram1[28][2], m2 >> 1, m2 & 1);
+        int s1 = eram_unpack(&eram_shadow, pcm.ram2[29][6] + pcm.tv_counter);
+        int t1 = addclip20(s1, pcm.ram1[28][2], 0); // 6
 
+        pcm.ram1[28][5] = addclip20(t1, pcm.ram1[28][5], 0);
 
-                pcm.ram1[28][1] = eram_unpack(&pcm, pcm.ram2[28][9] + pcm.tv_counter);
-            }
-            {
-                // 9
+        pcm.ram1[28][2] = eram_unpack(&eram_shadow, pcm.ram2[28][7] + pcm.tv_counter);
+    }
 
-                int v1 = pcm.ram2[30][6];
-                int m1 = multi(pcm.ram1[28][4], v1 >> 8) >> 5;
+    {
+        // 15
 
-                int v2 = addclip20(pcm.ram1[28][5], m1 >> 1, m1 & 1);
-                pcm.ram1[28][5] = v2;
-                int m2 = multi(v2, v1 & 255) >> 5;
-                pcm.ram1[28][4] = addclip20(pcm.ram1[28][4], m2 >> 1, m2 & 1);
+        int s1 = eram_unpack(&eram_shadow, pcm.ram2[28][11] + pcm.tv_counter);
+        pcm.ram1[28][2] = addclip20(pcm.ram1[28][2], s1, 0);
 
+        pcm.ram1[28][3] = eram_unpack(&eram_shadow, pcm.ram2[29][3] + pcm.tv_counter);
+    }
 
-                pcm.ram1[29][4] = eram_unpack(&pcm, pcm.ram2[29][5] + pcm.tv_counter);
-            }
-            {
-                // 10
-
-                int v1 = pcm.ram2[30][6];
-                int v2 = pcm.ram1[28][1];
-                int m1 = multi(v2, v1 >> 8) >> 5;
-                int s1 = eram_unpack(&pcm, pcm.ram2[28][8] + pcm.tv_counter);
-                int v3 = addclip20(m1 >> 1, s1, m1 & 1);
-                pcm.ram1[28][1] = v3;
-                int m2 = multi(v3, v1 & 255) >> 5;
-                pcm.ram1[29][5] = addclip20(m2 >> 1, v2, m2 & 1);
-
-                eram_pack(&pcm, pcm.ram2[28][4] + pcm.tv_counter, pcm.ram1[28][3]);
-            }
-            {
-                // 11
+    {
+        // 16
 
-                int v1 = pcm.ram2[30][6];
-                int v2 = pcm.ram1[29][4];
-                int m1 = multi(v2, v1 >> 8) >> 5;
-                int s1 = eram_unpack(&pcm, pcm.ram2[29][4] + pcm.tv_counter);
-                int v3 = addclip20(m1 >> 1, s1, m1 & 1);
-                pcm.ram1[29][4] = v3;
-                int m2 = multi(v3, v1 & 255) >> 5;
-                pcm.ram1[28][0] = addclip20(m2 >> 1, v2, m2 & 1);
+        int s1 = eram_unpack(&eram_shadow, pcm.ram2[29][7] + pcm.tv_counter);
+        int t1 = addclip20(s1, pcm.ram1[28][2], 0);
+        pcm.ram1[28][2] = addclip20(t1, pcm.ram1[28][3], 0);
 
 
-                eram_pack(&pcm, pcm.ram2[28][5] + pcm.tv_counter, pcm.ram1[28][2]);
+        eram_pack(&pcm, &eram_shadow, pcm.ram2[29][1] + pcm.tv_counter, pcm.ram1[28][4]);
 
-                eram_pack(&pcm, pcm.ram2[29][0] + pcm.tv_counter, pcm.ram1[28][5]);
-            }
-            {
-                // 12
+        eram_pack(&pcm, &eram_shadow, pcm.ram2[28][8] + pcm.tv_counter, pcm.ram1[28][1]);
+    }
 
-                pcm.ram1[28][5] = eram_unpack(&pcm, pcm.ram2[28][6] + pcm.tv_counter);
-            }
+    {
+        // 17
+        int v1 = pcm.ram2[30][2];
+        int v2 = pcm.ram1[28][5];
 
-            {
-                // 13
+        int m1 = multi(v2, v1 >> 8) >> 5;
 
-                int s1 = eram_unpack(&pcm, pcm.ram2[28][10] + pcm.tv_counter);
-                pcm.ram1[28][5] = addclip20(pcm.ram1[28][5], s1, 0);
+        rcadd[0] = m1;
 
-                pcm.ram1[28][2] = eram_unpack(&pcm, pcm.ram2[29][2] + pcm.tv_counter);
-            }
+        rcadd2[0] = multi(v2, v1 & 255) >> 5;
 
-            {
-                // 14
+        int t1 = eram_unpack(&eram_shadow, pcm.ram2[29][10] + pcm.tv_counter + 1); //? 3a6e
+        eram_pack(&pcm, &eram_shadow, pcm.ram2[28][9] + pcm.tv_counter, pcm.ram1[29][5]);
+        pcm.ram1[29][5] = t1;
+    }
 
-                int s1 = eram_unpack(&pcm, pcm.ram2[29][6] + pcm.tv_counter);
-                int t1 = addclip20(s1, pcm.ram1[28][2], 0); // 6
+    {
+        // 18
+        int v1 = pcm.ram2[30][3];
+        int v2 = pcm.ram1[28][2];
 
-                pcm.ram1[28][5] = addclip20(t1, pcm.ram1[28][5], 0);
+        int m1 = multi(v2, v1 >> 8) >> 5;
 
-                pcm.ram1[28][2] = eram_unpack(&pcm, pcm.ram2[28][7] + pcm.tv_counter);
-            }
+        rcadd[1] = m1;
 
-            {
-                // 15
+        rcadd2[1] = multi(v2, v1 & 255) >> 5;
 
-                int s1 = eram_unpack(&pcm, pcm.ram2[28][11] + pcm.tv_counter);
-                pcm.ram1[28][2] = addclip20(pcm.ram1[28][2], s1, 0);
+        pcm.ram1[28][1] = eram_unpack(&eram_shadow, pcm.ram2[29][11] + pcm.tv_counter + 1); //? 3a1e
+    }
+    {
+        // 19
 
-                pcm.ram1[28][3] = eram_unpack(&pcm, pcm.ram2[29][3] + pcm.tv_counter);
-            }
+        int v1 = pcm.ram2[31][9];
 
-            {
-                // 16
+        int s1 = eram_unpack(&eram_shadow, pcm.ram2[29][10] + pcm.tv_counter); //? 3a6d
 
-                int s1 = eram_unpack(&pcm, pcm.ram2[29][7] + pcm.tv_counter);
-                int t1 = addclip20(s1, pcm.ram1[28][2], 0);
-                pcm.ram1[28][2] = addclip20(t1, pcm.ram1[28][3], 0);
+        eram_pack(&pcm, &eram_shadow, pcm.ram2[29][4] + pcm.tv_counter, pcm.ram1[29][4]);
 
+        int m1 = multi(s1, v1 >> 8) >> 5;
+        int m2 = multi(pcm.ram1[29][5], v1 >> 8) >> 5;
 
-                eram_pack(&pcm, pcm.ram2[29][1] + pcm.tv_counter, pcm.ram1[28][4]);
+        int t2 = addclip20(s1, (m1 >> 1) ^ 0xfffff, 1);
 
-                eram_pack(&pcm, pcm.ram2[28][8] + pcm.tv_counter, pcm.ram1[28][1]);
-            }
+        pcm.ram1[29][5] = addclip20(t2, m2 >> 1, m2 & 1);
+    }
+    {
+        // 20
 
-            {
-                // 17
-                int v1 = pcm.ram2[30][2];
-                int v2 = pcm.ram1[28][5];
+        int v1 = pcm.ram2[31][10];
 
-                int m1 = multi(v2, v1 >> 8) >> 5;
+        int s1 = eram_unpack(&eram_shadow, pcm.ram2[29][11] + pcm.tv_counter); //? 3a1d
 
-                rcadd[0] = m1;
+        eram_pack(&pcm, &eram_shadow, pcm.ram2[29][5] + pcm.tv_counter, pcm.ram1[28][0]);
 
-                rcadd2[0] = multi(v2, v1 & 255) >> 5;
+        int m1 = multi(s1, v1 >> 8) >> 5;
+        int m2 = multi(pcm.ram1[28][1], v1 >> 8) >> 5;
 
-                int t1 = eram_unpack(&pcm, pcm.ram2[29][10] + pcm.tv_counter + 1); //? 3a6e
-                eram_pack(&pcm, pcm.ram2[28][9] + pcm.tv_counter, pcm.ram1[29][5]);
-                pcm.ram1[29][5] = t1;
-            }
+        int t2 = addclip20(s1, (m1 >> 1) ^ 0xfffff, 1);
 
-            {
-                // 18
-                int v1 = pcm.ram2[30][3];
-                int v2 = pcm.ram1[28][2];
+        pcm.ram1[28][1] = addclip20(t2, m2 >> 1, m2 & 1);
 
-                int m1 = multi(v2, v1 >> 8) >> 5;
+        eram_pack(&pcm, &eram_shadow, pcm.ram2[29][9] + pcm.tv_counter, pcm.ram1[29][1]);
+    }
+    {
+        // 21
 
-                rcadd[1] = m1;
+        int v1 = pcm.ram2[31][2];
+        int v2 = pcm.ram1[29][5];
 
-                rcadd2[1] = multi(v2, v1 & 255) >> 5;
+        int m1 = multi(v2, v1 >> 8) >> 5;
+        int m2 = multi(v2, v1 & 255) >> 5;
 
-                pcm.ram1[28][1] = eram_unpack(&pcm, pcm.ram2[29][11] + pcm.tv_counter + 1); //? 3a1e
-            }
-            {
-                // 19
+        rcadd[2] = m1;
+        rcadd2[2] = m2;
+    }
+    {
+        // 22
 
-                int v1 = pcm.ram2[31][9];
+        int v1 = pcm.ram2[31][3];
+        int v2 = pcm.ram1[29][5];
 
-                int s1 = eram_unpack(&pcm, pcm.ram2[29][10] + pcm.tv_counter); //? 3a6d
+        int m1 = multi(v2, v1 >> 8) >> 5;
+        int m2 = multi(v2, v1 & 255) >> 5;
 
-                eram_pack(&pcm, pcm.ram2[29][4] + pcm.tv_counter, pcm.ram1[29][4]);
+        rcadd[3] = m1;
+        rcadd2[3] = m2;
+    }
+    {
+        // 23
 
-                int m1 = multi(s1, v1 >> 8) >> 5;
-                int m2 = multi(pcm.ram1[29][5], v1 >> 8) >> 5;
+        int v1 = pcm.ram2[31][4];
+        int v2 = pcm.ram1[28][1];
 
-                int t2 = addclip20(s1, (m1 >> 1) ^ 0xfffff, 1);
+        int m1 = multi(v2, v1 >> 8) >> 5;
+        int m2 = multi(v2, v1 & 255) >> 5;
 
-                pcm.ram1[29][5] = addclip20(t2, m2 >> 1, m2 & 1);
-            }
-            {
-                // 20
+        rcadd[4] = m1;
+        rcadd2[4] = m2;
+    }
+    {
+        // 31
 
-                int v1 = pcm.ram2[31][10];
+        int v1 = pcm.ram2[31][5];
+        int v2 = pcm.ram1[28][1];
 
-                int s1 = eram_unpack(&pcm, pcm.ram2[29][11] + pcm.tv_counter); //? 3a1d
+        int m1 = multi(v2, v1 >> 8) >> 5;
+        int m2 = multi(v2, v1 & 255) >> 5;
 
-                eram_pack(&pcm, pcm.ram2[29][5] + pcm.tv_counter, pcm.ram1[28][0]);
+        rcadd[5] = m1;
+        rcadd2[5] = m2;
+    }
+}
 
-                int m1 = multi(s1, v1 >> 8) >> 5;
-                int m2 = multi(pcm.ram1[28][1], v1 >> 8) >> 5;
+// Notes younger than this are only stolen when nothing older is left, so a
+// new note in its attack doesn't lose out to a louder old one (~50 ms)
+static const int VOICE_ONSET_GUARD_FRAMES = 1600;
 
-                int t2 = addclip20(s1, (m1 >> 1) ^ 0xfffff, 1);
+uint32_t Pcm::PCM_StealVoices(uint32_t active)
+{
+    uint32_t stolen = voice_stolen.load(std::memory_order_relaxed) & active;
+    for (uint32_t m = active; m; m &= m - 1)
+    {
+        int slot = __builtin_ctz(m);
+        if ((pcm.ram2[slot][7] & 0x20) == 0) // kon pending: a new note
+        {
+            voice_onset[slot] = pcm.cycles;
+            stolen &= ~(1u << slot);
+        }
+    }
 
-                pcm.ram1[28][1] = addclip20(t2, m2 >> 1, m2 & 1);
+    uint32_t playing = active & ~stolen;
+    int excess = __builtin_popcount(playing) - voice_limit;
+    const uint64_t guard = VOICE_ONSET_GUARD_FRAMES * PCM_FrameCycles(pcm.config_reg_3d);
+    for (; excess > 0; excess--)
+    {
+        uint32_t candidates = playing & ~irq_enable_mask;
+        uint32_t settled = 0;
+        for (uint32_t m = candidates; m; m &= m - 1)
+        {
+            int slot = __builtin_ctz(m);
+            if (pcm.cycles - voice_onset[slot] >= guard)
+                settled |= 1u << slot;
+        }
+        if (settled)
+            candidates = settled;
+        if (!candidates)
+            break;
 
-                eram_pack(&pcm, pcm.ram2[29][9] + pcm.tv_counter, pcm.ram1[29][1]);
-            }
+        int victim = 0;
+        int victim_level = 0x7fffffff;
+        for (uint32_t m = candidates; m; m &= m - 1)
+        {
+            int slot = __builtin_ctz(m);
+            int level = (pcm.ram2[slot][9] >> 8) * (pcm.ram2[slot][10] >> 8);
+            if (level < victim_level)
             {
-                // 21
-
-                int v1 = pcm.ram2[31][2];
-                int v2 = pcm.ram1[29][5];
+                victim = slot;
+                victim_level = level;
+            }
+        }
+        stolen |= 1u << victim;
+        playing &= ~(1u << victim);
+    }
 
-                int m1 = multi(v2, v1 >> 8) >> 5;
-                int m2 = multi(v2, v1 & 255) >> 5;
+    voice_stolen.store(stolen, std::memory_order_relaxed);
+    return playing;
+}
 
-                rcadd[2] = m1;
-                rcadd2[2] = m2;
-            }
-            {
-                // 22
+static inline void meter_peak(int *peak, const int *tt)
+{
+    int l = tt[0] >> 16;
+    int r = tt[1] >> 16;
+    if (l < 0)
+        l = -l;
+    if (r > l)
+        l = r;
+    else if (-r > l)
+        l = -r;
+    if (l > *peak)
+        *peak = l;
+}
 
-                int v1 = pcm.ram2[31][3];
-                int v2 = pcm.ram1[29][5];
+// Raise a shared peak; the reader may zero it at any time
+static inline void meter_raise(std::atomic<int> *peak, int value)
+{
+    int cur = peak->load(std::memory_order_relaxed);
+    while (value > cur &&
+           !peak->compare_exchange_weak(cur, value, std::memory_order_relaxed))
+    {
+    }
+}
 
-                int m1 = multi(v2, v1 >> 8) >> 5;
-                int m2 = multi(v2, v1 & 255) >> 5;
+// Once per PCM_Update: the keyed slots don't change between PCM writes
+static void meter_voices(pcm_meter_t *meter, const pcm_t *pcm, uint32_t active)
+{
+    meter->active_mask.store(active, std::memory_order_relaxed);
+    meter_raise(&meter->active_peak, __builtin_popcount(active));
 
-                rcadd[3] = m1;
-                rcadd2[3] = m2;
-            }
-            {
-                // 23
+    for (int slot = 0; slot < 32; slot++)
+    {
+        int level = (pcm->ram2[slot][9] >> 8) * (pcm->ram2[slot][10] >> 8);
+        meter->level[slot].store(((active >> slot) & 1) ? level : 0,
+                                 std::memory_order_relaxed);
+    }
+}
 
-                int v1 = pcm.ram2[31][4];
-                int v2 = pcm.ram1[28][1];
+void Pcm::PCM_Update(uint64_t cycles)
+{
+    int reg_slots = (pcm.config_reg_3d & 31) + 1;
+    int voice_active = pcm.voice_mask & pcm.voice_mask_pending;
+    if ((voice_limit < 32 || voice_stolen.load(std::memory_order_relaxed)) &&
+        pcm.cycles < cycles)
+        voice_active = PCM_StealVoices(voice_active);
+    const uint64_t frame_cycles = PCM_FrameCycles(pcm.config_reg_3d);
+    const bool oversampling = PCM_FrameSamples() == 4;
+    const uint64_t start_cycles = pcm.cycles;
+    int out_peak = 0;
+    while (pcm.cycles < cycles)
+    {
+        int tt[2] = {};
 
-                int m1 = multi(v2, v1 >> 8) >> 5;
-                int m2 = multi(v2, v1 & 255) >> 5;
+        { // final mixing
+            int noise_mask = 0;
+            int orval = 0;
+            int write_mask = 3;
+            // int dac_mask = -4;
 
-                rcadd[4] = m1;
-                rcadd2[4] = m2;
-            }
-            {
-                // 31
 
-                int v1 = pcm.ram2[31][5];
-                int v2 = pcm.ram1[28][1];
+            int shifter = pcm.ram2[30][10];
+            int xr = ((shifter >> 0) ^ (shifter >> 1) ^ (shifter >> 7) ^ (shifter >> 12)) & 1;
+            shifter = (shifter >> 1) | (xr << 15);
+            pcm.ram2[30][10] = shifter;
 
-                int m1 = multi(v2, v1 >> 8) >> 5;
-                int m2 = multi(v2, v1 & 255) >> 5;
+            pcm.accum_l = addclip20(pcm.accum_l, pcm.ram1[30][0], 0);
+            pcm.accum_r = addclip20(pcm.accum_r, pcm.ram1[30][1], 0);
 
-                rcadd[5] = m1;
-                rcadd2[5] = m2;
+            pcm.ram1[30][2] = addclip20(pcm.accum_l,
+                orval | (shifter & noise_mask), 0);
 
-                {
-                    // address generator
-
-                    int key = 1;
-                    int okey = (pcm.ram2[31][7] & 0x20) != 0;
-                    int active = key && okey;
-                    int kon = key && !okey;
-
-                    int b15 = (pcm.ram2[31][8] & 0x8000) != 0; // 0
-                    int b6 = (pcm.ram2[31][7] & 0x40) != 0; // 1
-                    int b7 = (pcm.ram2[31][7] & 0x80) != 0; // 1
-                    int old_nibble = (pcm.ram2[31][7] >> 12) & 15; // 1
-
-                    int address = pcm.ram1[31][4]; // 0
-                    int address_end = pcm.ram1[31][0]; // 1 or 2
-                    int address_loop = pcm.ram1[31][2]; // 2 or 1
-
-                    int sub_phase = (pcm.ram2[31][8] & 0x3fff); // 1
-                    int interp_ratio = (sub_phase >> 7) & 127;
-                    sub_phase += pcm.ram2[pcm.ram2[31][7] & 31][0]; // 5
-                    int sub_phase_of = (sub_phase >> 14) & 7;
-                    if (pcm.nfs)
-                    {
-                        pcm.ram2[31][8] &= ~0x3fff;
-                        pcm.ram2[31][8] |= sub_phase & 0x3fff;
-                    }
+            pcm.ram1[30][4] = addclip20(pcm.accum_r,
+                orval | (shifter & noise_mask), 0);
 
+            pcm.ram1[30][0] = pcm.accum_l & write_mask;
+            pcm.ram1[30][1] = pcm.accum_r & write_mask;
+            
 
-                    // address 0
-                    int address_cnt = address;
+            tt[0] = (int)((pcm.ram1[30][2] & ~write_mask) << 12);
+            tt[1] = (int)((pcm.ram1[30][4] & ~write_mask) << 12);
 
-                    int cmp1 = b15 ? address_loop : address_end;
-                    int cmp2 = address_cnt;
-                    int address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 9
-                    int next_b15 = b15;
+            mcu->MCU_PostSample(tt);
+            meter_peak(&out_peak, tt);
 
-                    int next_address = address_cnt; // 11
+            xr = ((shifter >> 0) ^ (shifter >> 1) ^ (shifter >> 7) ^ (shifter >> 12)) & 1;
+            shifter = (shifter >> 1) | (xr << 15);
 
-                    cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
-                    cmp2 = address_cnt;
-                    int address_cnt2 = (kon || (!b6 && address_cmp)) ? cmp1 : cmp2;
+            pcm.accum_l = addclip20(pcm.accum_l, pcm.ram1[30][0], 0);
+            pcm.accum_r = addclip20(pcm.accum_r, pcm.ram1[30][1], 0);
 
-                    int address_add = (!address_cmp && b6 && !b15) || (!address_cmp && !b6);
-                    int address_sub = !address_cmp && b6 && b15;
-                    if (b7)
-                        address_cnt2 -= address_add - address_sub;
-                    else
-                        address_cnt2 += address_add - address_sub;
-                    address_cnt = address_cnt2 & 0xfffff; // 11
-                    b15 = b6 && (b15 ^ address_cmp); // 11
+            pcm.ram1[30][3] = addclip20(pcm.accum_l,
+                orval | (shifter & noise_mask), 0);
 
-                    cmp1 = b15 ? address_loop : address_end;
-                    cmp2 = address_cnt;
-                    address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 13
+            pcm.ram1[30][5] = addclip20(pcm.accum_r,
+                orval | (shifter & noise_mask), 0);
 
-                    if (sub_phase_of >= 1)
-                    {
-                        next_address = address_cnt; // 13
-                        next_b15 = b15;
-                    }
+            if (oversampling) // see output_mode
+            {
+                pcm.ram2[30][10] = shifter;
 
-                    if (active && pcm.nfs)
-                        pcm.ram1[31][4] = next_address;
+                pcm.ram1[30][0] = pcm.accum_l & write_mask;
+                pcm.ram1[30][1] = pcm.accum_r & write_mask;
 
-                    if (pcm.nfs)
-                    {
-                        pcm.ram2[31][8] &= ~0x8000;
-                        pcm.ram2[31][8] |= next_b15 << 15;
-                    }
 
-                    int t1 = address_loop; // 18
-                    int t2 = pcm.ram1[31][4] - t1; // 19
-                    int t3 = address_end - t2; // 20
-                    int t4 = pcm.ram1[31][4]; // 23
+                tt[0] = (int)((pcm.ram1[30][3] & ~write_mask) << 12);
+                tt[1] = (int)((pcm.ram1[30][5] & ~write_mask) << 12);
 
-                    pcm.ram2[29][10] = t3;
-                    pcm.ram2[29][11] = t4;
-                }
+                mcu->MCU_PostSample(tt);
+                meter_peak(&out_peak, tt);
             }
         }
 
-        pcm.ram1[31][1] = 0;
-        pcm.ram1[31][3] = 0;
-        pcm.rcsum[0] = 0;
-        pcm.rcsum[1] = 0;
+        { // global counter for envelopes
+            if (!pcm.nfs)
+                pcm.tv_counter = pcm.ram2[31][8]; // fixme
 
-        // uint8_t irq_assert_per_slot[32] = {0};
-        // uint8_t irq_channel_per_slot[32] = {0};
-        // int sampl_per_slot[32] = {0};
-        // int sampr_per_slot[32] = {0};
-        // int rc0_per_slot[32] = {0};
-        // int rc1_per_slot[32] = {0};
+            pcm.tv_counter -= 1;
 
-        for (int slot = 0; slot < reg_slots; slot++)
-        {
-            uint32_t *ram1 = pcm.ram1[slot];
-            uint16_t *ram2 = pcm.ram2[slot];
-            int okey = (ram2[7] & 0x20) != 0;
-            int key = (voice_active >> slot) & 1;
+            pcm.tv_counter &= 0x3fff;
+        }
 
-            int active = okey && key;
-            int kon = key && !okey;
+        // chorus/reverb
 
-            // address generator
+        { // fixme
+            if (pcm.ram2[31][8] & 0x8000)
+                pcm.ram2[31][9] = pcm.ram2[31][8] & 0x7fff;
+            else
+                pcm.ram2[31][10] = pcm.ram2[31][8] & 0x7fff;
+
+            if ((0x4000 - pcm.ram2[31][8]) & 0x8000)
+                pcm.ram2[31][10] = (0x4000 - pcm.ram2[31][8]) & 0x7fff;
+            else
+                pcm.ram2[31][9] = (0x4000 - pcm.ram2[31][8]) & 0x7fff;
+        }
+
+        {
+            int okey = (pcm.ram2[31][7] & 0x20) != 0;
+            int key = 1;
+            int active = okey && key;
+            int u = 0;
+            calc_tv(&pcm, 1, pcm.ram2[30][0], &pcm.ram2[30][9], active, &u);
+        }
 
-            int b15 = (ram2[8] & 0x8000) != 0; // 0
-            int b6 = (ram2[7] & 0x40) != 0; // 1
-            int b7 = (ram2[7] & 0x80) != 0; // 1
-            int hiaddr = (ram2[7] >> 8) & 15; // 1
-            int old_nibble = (ram2[7] >> 12) & 15; // 1
+        // An idle network stays all-zero, so skipping it leaves the same
+        // state; rcadd/rcadd2 are then zero as it would return them.
+        int rcadd[6] = {};
+        int rcadd2[6] = {};
+        if (!PCM_EffectsIdle())
+            PCM_ReverbChorus(rcadd, rcadd2);
 
-            int address = ram1[4]; // 0
-            int address_end = ram1[0]; // 1 or 2
-            int address_loop = ram1[2]; // 2 or 1
+        {
+            // address generator (slot 31, sets the modulated taps for 17-20)
 
-            int cmp1 = b15 ? address_loop : address_end;
-            int cmp2 = address;
-            int nibble_cmp1 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 2
-            int irq_flag = 0;
+            int key = 1;
+            int okey = (pcm.ram2[31][7] & 0x20) != 0;
+            int active = key && okey;
+            int kon = key && !okey;
 
-            // fixme:
-            if (kon)
-                irq_flag = ((cmp1 + address_loop) & 0x100000) != 0;
-            else
-                irq_flag = ((address + ((-address_loop) & 0xfffff)) & 0x100000) != 0;
-            irq_flag ^= b7;
-
-            int nibble_address = (!b6 && nibble_cmp1) ? address_loop : address; // 3
-            int address_b4 = (nibble_address & 0x10) != 0;
-            int wave_address = nibble_address >> 5;
-            int xor2 = (address_b4 ^ b7);
-            int check1 = xor2 && active;
-            int xor1 = (b15 ^ !nibble_cmp1);
-            int nibble_add = b6 ? check1 && xor1 : (!nibble_cmp1 && check1);
-            int nibble_subtract = b6 && !xor1 && active && !xor2;
-            if (b7)
-                wave_address -= nibble_add - nibble_subtract;
-            else
-                wave_address += nibble_add - nibble_subtract;
-            wave_address &= 0xfffff;
+            int b15 = (pcm.ram2[31][8] & 0x8000) != 0; // 0
+            int b6 = (pcm.ram2[31][7] & 0x40) != 0; // 1
+            int b7 = (pcm.ram2[31][7] & 0x80) != 0; // 1
+            int old_nibble = (pcm.ram2[31][7] >> 12) & 15; // 1
 
-            int newnibble = PCM_ReadROM((hiaddr << 20) | wave_address);
-            int newnibble_sel = address_b4 ^ ((b6 || !nibble_cmp1) && okey);
-            if (newnibble_sel)
-                newnibble = (newnibble >> 4) & 15;
-            else
-                newnibble &= 15;
+            int address = pcm.ram1[31][4]; // 0
+            int address_end = pcm.ram1[31][0]; // 1 or 2
+            int address_loop = pcm.ram1[31][2]; // 2 or 1
 
-            int sub_phase = (ram2[8] & 0x3fff); // 1
+            int sub_phase = (pcm.ram2[31][8] & 0x3fff); // 1
             int interp_ratio = (sub_phase >> 7) & 127;
-            sub_phase += pcm.ram2[ram2[7] & 31][0]; // 5
+            sub_phase += pcm.ram2[pcm.ram2[31][7] & 31][0]; // 5
             int sub_phase_of = (sub_phase >> 14) & 7;
             if (pcm.nfs)
             {
-                ram2[8] &= ~0x3fff;
-                ram2[8] |= sub_phase & 0x3fff;
+                pcm.ram2[31][8] &= ~0x3fff;
+                pcm.ram2[31][8] |= sub_phase & 0x3fff;
             }
 
 
             // address 0
             int address_cnt = address;
-            int samp0 = (int8_t)PCM_ReadROM((hiaddr << 20) | address_cnt); // 18
 
-            cmp1 = address;
-            cmp2 = address_cnt;
-            int nibble_cmp2 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 8
-            cmp1 = b15 ? address_loop : address_end;
-            cmp2 = address_cnt;
+            int cmp1 = b15 ? address_loop : address_end;
+            int cmp2 = address_cnt;
             int address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 9
+            int next_b15 = b15;
 
             int next_address = address_cnt; // 11
-            int usenew = !nibble_cmp2;
-            int next_b15 = b15;
 
             cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
             cmp2 = address_cnt;
@@ -1045,11 +1195,6 @@ void Pcm::PCM_Update(uint64_t cycles)
             address_cnt = address_cnt2 & 0xfffff; // 11
             b15 = b6 && (b15 ^ address_cmp); // 11
 
-            int samp1 = (int8_t)PCM_ReadROM((hiaddr << 20) | address_cnt); // 20
-
-            cmp1 = address;
-            cmp2 = address_cnt;
-            int nibble_cmp3 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 12
             cmp1 = b15 ? address_loop : address_end;
             cmp2 = address_cnt;
             address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 13
@@ -1057,358 +1202,476 @@ void Pcm::PCM_Update(uint64_t cycles)
             if (sub_phase_of >= 1)
             {
                 next_address = address_cnt; // 13
-                usenew = !nibble_cmp3;
                 next_b15 = b15;
             }
 
-            cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
-            cmp2 = address_cnt;
-            address_cnt2 = (kon || (!b6 && address_cmp)) ? cmp1 : cmp2;
-
-            address_add = (!address_cmp && b6 && !b15) || (!address_cmp && !b6);
-            address_sub = !address_cmp && b6 && b15;
-            if (b7)
-                address_cnt2 -= address_add - address_sub;
-            else
-                address_cnt2 += address_add - address_sub;
-            address_cnt = address_cnt2 & 0xfffff; // 15
-            b15 = b6 && (b15 ^ address_cmp); // 15
-
-            int samp2 = (int8_t)PCM_ReadROM((hiaddr << 20) | address_cnt); // 1
-
-            cmp1 = address;
-            cmp2 = address_cnt;
-            int nibble_cmp4 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 16
-            cmp1 = b15 ? address_loop : address_end;
-            cmp2 = address_cnt;
-            address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 17
-
-            if (sub_phase_of >= 2)
-            {
-                next_address = address_cnt; // 17
-                usenew = !nibble_cmp4;
-                next_b15 = b15;
-            }
-
-            cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
-            cmp2 = address_cnt;
-            address_cnt2 = (kon || (!b6 && address_cmp)) ? cmp1 : cmp2;
-
-            address_add = (!address_cmp && b6 && !b15) || (!address_cmp && !b6);
-            address_sub = !address_cmp && b6 && b15;
-            if (b7)
-                address_cnt2 -= address_add - address_sub;
-            else
-                address_cnt2 += address_add - address_sub;
-            address_cnt = address_cnt2 & 0xfffff; // 19
-            b15 = b6 && (b15 ^ address_cmp); // 19
-
-            int samp3 = (int8_t)PCM_ReadROM((hiaddr << 20) | address_cnt); // 5
-
-            cmp1 = address;
-            cmp2 = address_cnt;
-            int nibble_cmp5 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 20
-            cmp1 = b15 ? address_loop : address_end;
-            cmp2 = address_cnt;
-            address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 21
-
-            if (sub_phase_of >= 3)
-            {
-                next_address = address_cnt; // 21
-                usenew = !nibble_cmp5;
-                next_b15 = b15;
-            }
-
-            cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
-            cmp2 = address_cnt;
-            address_cnt2 = (kon || (!b6 && address_cmp)) ? cmp1 : cmp2;
-
-            address_add = (!address_cmp && b6 && !b15) || (!address_cmp && !b6);
-            address_sub = !address_cmp && b6 && b15;
-            if (b7)
-                address_cnt2 -= address_add - address_sub;
-            else
-                address_cnt2 += address_add - address_sub;
-            address_cnt = address_cnt2 & 0xfffff; // 23
-            // b15 = b6 && (b15 ^ address_cmp); // 23
-
-            cmp1 = address;
-            cmp2 = address_cnt;
-            int nibble_cmp6 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 24
-
-            if (sub_phase_of >= 4)
-            {
-                next_address = address_cnt; // 1
-                usenew = !nibble_cmp6;
-                // b15 is not updated?
-            }
-
             if (active && pcm.nfs)
-                ram1[4] = next_address;
+                pcm.ram1[31][4] = next_address;
 
             if (pcm.nfs)
             {
-                ram2[8] &= ~0x8000;
-                ram2[8] |= next_b15 << 15;
+                pcm.ram2[31][8] &= ~0x8000;
+                pcm.ram2[31][8] |= next_b15 << 15;
             }
 
-            // dpcm
+            int t1 = address_loop; // 18
+            int t2 = pcm.ram1[31][4] - t1; // 19
+            int t3 = address_end - t2; // 20
+            int t4 = pcm.ram1[31][4]; // 23
 
-            // 18
-            int reference = ram1[5];
+            pcm.ram2[29][10] = t3;
+            pcm.ram2[29][11] = t4;
+        }
 
-            // 19
-            int preshift = samp0 << 10;
-            int select_nibble = nibble_cmp2 ? old_nibble : newnibble;
-            int shift = (10 - select_nibble) & 15;
+        pcm.ram1[31][1] = 0;
+        pcm.ram1[31][3] = 0;
+        pcm.rcsum[0] = 0;
+        pcm.rcsum[1] = 0;
 
-            int shifted = (preshift << 1) >> shift;
+        // uint8_t irq_assert_per_slot[32] = {0};
+        // uint8_t irq_channel_per_slot[32] = {0};
+        // int sampl_per_slot[32] = {0};
+        // int sampr_per_slot[32] = {0};
+        // int rc0_per_slot[32] = {0};
+        // int rc1_per_slot[32] = {0};
 
-            if (sub_phase_of >= 1)
-                reference = addclip20(reference, shifted >> 1, shifted & 1);
+        // The slots run in three passes over pcm_voice_lanes_t: the scalar
+        // front end (address generator, DPCM, interpolation, envelopes), the
+        // vectorised filter/volume/pan stage, then IRQ and mixing in slot
+        // order. With all 32 slots in use, slot 31's filter registers double
+        // as the mix accumulator, so it runs as a second batch once slots
+        // 0-30 have been mixed.
+        pcm_voice_lanes_t *lanes = &voice_lanes;
+        int batch_end = reg_slots == 32 ? 31 : reg_slots;
+        for (int batch_start = 0; batch_start < reg_slots; batch_start = batch_end, batch_end = reg_slots)
+        {
+            for (int slot = batch_start; slot < batch_end; slot++)
+            {
+                uint32_t *ram1 = pcm.ram1[slot];
+                uint16_t *ram2 = pcm.ram2[slot];
+                int okey = (ram2[7] & 0x20) != 0;
+                int key = (voice_active >> slot) & 1;
+
+                int active = okey && key;
+                int kon = key && !okey;
+
+                // Quiescent slot: with its key bit clear the slot ends the
+                // frame with ram1[1]/[3]/[5] and the level envelopes zeroed
+                // and mixes silence, whatever state it started in. Only the
+                // filter envelope, which is reloaded from its target while
+                // inactive, and the reverb/chorus hooks still have to run.
+                if (!key && pcm.nfs)
+                {
+                    ram1[5] = 0;
+                    ram2[8] = 0;
+                    ram2[9] = 0;
+                    ram2[10] = 0;
+                    calc_tv(&pcm, 2, ram2[5], &ram2[11], 0, NULL);
+
+                    lanes->irq[slot] = 0;
+                    lanes->pan[slot] = 0;
+                    lanes->rc[slot] = 0;
+                    lanes->clear[slot] = 1;
+                    continue;
+                }
 
-            preshift = samp1 << 10;
-            select_nibble = nibble_cmp3 ? old_nibble : newnibble;
-            shift = (10 - select_nibble) & 15;
+                // address generator
+
+                int b15 = (ram2[8] & 0x8000) != 0; // 0
+                int b6 = (ram2[7] & 0x40) != 0; // 1
+                int b7 = (ram2[7] & 0x80) != 0; // 1
+                int hiaddr = (ram2[7] >> 8) & 15; // 1
+                int old_nibble = (ram2[7] >> 12) & 15; // 1
+
+                int address = ram1[4]; // 0
+                int address_end = ram1[0]; // 1 or 2
+                int address_loop = ram1[2]; // 2 or 1
+
+                int cmp1 = b15 ? address_loop : address_end;
+                int cmp2 = address;
+                int nibble_cmp1 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 2
+                int irq_flag = 0;
+
+                // fixme:
+                if (kon)
+                    irq_flag = ((cmp1 + address_loop) & 0x100000) != 0;
+                else
+                    irq_flag = ((address + ((-address_loop) & 0xfffff)) & 0x100000) != 0;
+                irq_flag ^= b7;
+
+                int nibble_address = (!b6 && nibble_cmp1) ? address_loop : address; // 3
+                int address_b4 = (nibble_address & 0x10) != 0;
+                int wave_address = nibble_address >> 5;
+                int xor2 = (address_b4 ^ b7);
+                int check1 = xor2 && active;
+                int xor1 = (b15 ^ !nibble_cmp1);
+                int nibble_add = b6 ? check1 && xor1 : (!nibble_cmp1 && check1);
+                int nibble_subtract = b6 && !xor1 && active && !xor2;
+                if (b7)
+                    wave_address -= nibble_add - nibble_subtract;
+                else
+                    wave_address += nibble_add - nibble_subtract;
+                wave_address &= 0xfffff;
+
+                int newnibble = PCM_ReadROM((hiaddr << 20) | wave_address);
+                int newnibble_sel = address_b4 ^ ((b6 || !nibble_cmp1) && okey);
+                if (newnibble_sel)
+                    newnibble = (newnibble >> 4) & 15;
+                else
+                    newnibble &= 15;
+
+                int sub_phase = (ram2[8] & 0x3fff); // 1
+                int interp_ratio = (sub_phase >> 7) & 127;
+                sub_phase += pcm.ram2[ram2[7] & 31][0]; // 5
+                int sub_phase_of = (sub_phase >> 14) & 7;
+                if (pcm.nfs)
+                {
+                    ram2[8] &= ~0x3fff;
+                    ram2[8] |= sub_phase & 0x3fff;
+                }
 
-            shifted = (preshift << 1) >> shift;
 
-            if (sub_phase_of >= 2)
-                reference = addclip20(reference, shifted >> 1, shifted & 1);
+                // address 0
+                int address_cnt = address;
+                int samp0 = (int8_t)PCM_ReadROM((hiaddr << 20) | address_cnt); // 18
+
+                cmp1 = address;
+                cmp2 = address_cnt;
+                int nibble_cmp2 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 8
+                cmp1 = b15 ? address_loop : address_end;
+                cmp2 = address_cnt;
+                int address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 9
+
+                int next_address = address_cnt; // 11
+                int usenew = !nibble_cmp2;
+                int next_b15 = b15;
+
+                cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
+                cmp2 = address_cnt;
+                int address_cnt2 = (kon || (!b6 && address_cmp)) ? cmp1 : cmp2;
+
+                int address_add = (!address_cmp && b6 && !b15) || (!address_cmp && !b6);
+                int address_sub = !address_cmp && b6 && b15;
+                if (b7)
+                    address_cnt2 -= address_add - address_sub;
+                else
+                    address_cnt2 += address_add - address_sub;
+                address_cnt = address_cnt2 & 0xfffff; // 11
+                b15 = b6 && (b15 ^ address_cmp); // 11
+
+                int samp1 = (int8_t)PCM_ReadROM((hiaddr << 20) | address_cnt); // 20
+
+                cmp1 = address;
+                cmp2 = address_cnt;
+                int nibble_cmp3 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 12
+                cmp1 = b15 ? address_loop : address_end;
+                cmp2 = address_cnt;
+                address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 13
+
+                if (sub_phase_of >= 1)
+                {
+                    next_address = address_cnt; // 13
+                    usenew = !nibble_cmp3;
+                    next_b15 = b15;
+                }
 
-            preshift = samp2 << 10;
-            select_nibble = nibble_cmp4 ? old_nibble : newnibble;
-            shift = (10 - select_nibble) & 15;
+                cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
+                cmp2 = address_cnt;
+                address_cnt2 = (kon || (!b6 && address_cmp)) ? cmp1 : cmp2;
+
+                address_add = (!address_cmp && b6 && !b15) || (!address_cmp && !b6);
+                address_sub = !address_cmp && b6 && b15;
+                if (b7)
+                    address_cnt2 -= address_add - address_sub;
+                else
+                    address_cnt2 += address_add - address_sub;
+                address_cnt = address_cnt2 & 0xfffff; // 15
+                b15 = b6 && (b15 ^ address_cmp); // 15
+
+                int samp2 = (int8_t)PCM_ReadROM((hiaddr << 20) | address_cnt); // 1
+
+                cmp1 = address;
+                cmp2 = address_cnt;
+                int nibble_cmp4 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 16
+                cmp1 = b15 ? address_loop : address_end;
+                cmp2 = address_cnt;
+                address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 17
+
+                if (sub_phase_of >= 2)
+                {
+                    next_address = address_cnt; // 17
+                    usenew = !nibble_cmp4;
+                    next_b15 = b15;
+                }
 
-            shifted = (preshift << 1) >> shift;
+                cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
+                cmp2 = address_cnt;
+                address_cnt2 = (kon || (!b6 && address_cmp)) ? cmp1 : cmp2;
+
+                address_add = (!address_cmp && b6 && !b15) || (!address_cmp && !b6);
+                address_sub = !address_cmp && b6 && b15;
+                if (b7)
+                    address_cnt2 -= address_add - address_sub;
+                else
+                    address_cnt2 += address_add - address_sub;
+                address_cnt = address_cnt2 & 0xfffff; // 19
+                b15 = b6 && (b15 ^ address_cmp); // 19
+
+                int samp3 = (int8_t)PCM_ReadROM((hiaddr << 20) | address_cnt); // 5
+
+                cmp1 = address;
+                cmp2 = address_cnt;
+                int nibble_cmp5 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 20
+                cmp1 = b15 ? address_loop : address_end;
+                cmp2 = address_cnt;
+                address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 21
+
+                if (sub_phase_of >= 3)
+                {
+                    next_address = address_cnt; // 21
+                    usenew = !nibble_cmp5;
+                    next_b15 = b15;
+                }
 
-            if (sub_phase_of >= 3)
-                reference = addclip20(reference, shifted >> 1, shifted & 1);
+                cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
+                cmp2 = address_cnt;
+                address_cnt2 = (kon || (!b6 && address_cmp)) ? cmp1 : cmp2;
 
-            preshift = samp3 << 10;
-            select_nibble = nibble_cmp5 ? old_nibble : newnibble;
-            shift = (10 - select_nibble) & 15;
+                address_add = (!address_cmp && b6 && !b15) || (!address_cmp && !b6);
+                address_sub = !address_cmp && b6 && b15;
+                if (b7)
+                    address_cnt2 -= address_add - address_sub;
+                else
+                    address_cnt2 += address_add - address_sub;
+                address_cnt = address_cnt2 & 0xfffff; // 23
+                // b15 = b6 && (b15 ^ address_cmp); // 23
 
-            shifted = (preshift << 1) >> shift;
+                cmp1 = address;
+                cmp2 = address_cnt;
+                int nibble_cmp6 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 24
 
-            if (sub_phase_of >= 4)
-                reference = addclip20(reference, shifted >> 1, shifted & 1);
+                if (sub_phase_of >= 4)
+                {
+                    next_address = address_cnt; // 1
+                    usenew = !nibble_cmp6;
+                    // b15 is not updated?
+                }
 
-            // interpolation
+                if (active && pcm.nfs)
+                {
+                    ram1[4] = next_address;
 
-            int test = ram1[5];
+                    // next frame's sample and nibble fetches
+                    PCM_PrefetchROM((hiaddr << 20) | next_address);
+                    PCM_PrefetchROM((hiaddr << 20) | (next_address >> 5));
+                }
 
-            int step0 = multi(interp_lut[0][interp_ratio] << 6, samp0) >> 8;
-            select_nibble = nibble_cmp2 ? old_nibble : newnibble;
-            shift = (10 - select_nibble) & 15;
-            step0 =  (step0 << 1) >> shift;
+                if (pcm.nfs)
+                {
+                    ram2[8] &= ~0x8000;
+                    ram2[8] |= next_b15 << 15;
+                }
 
-            test = addclip20(test, step0 >> 1, step0 & 1);
+                // dpcm
 
+                // 18
+                int reference = ram1[5];
 
-            int step1 = multi(interp_lut[1][interp_ratio] << 6, samp1) >> 8;
-            select_nibble = nibble_cmp3 ? old_nibble : newnibble;
-            shift = (10 - select_nibble) & 15;
-            step1 = (step1 << 1) >> shift;
+                // 19
+                int preshift = samp0 << 10;
+                int select_nibble = nibble_cmp2 ? old_nibble : newnibble;
+                int shift = (10 - select_nibble) & 15;
 
-            test = addclip20(test, step1 >> 1, step1 & 1);
+                int shifted = (preshift << 1) >> shift;
 
-            int step2 = multi(interp_lut[2][interp_ratio] << 6, samp2) >> 8;
-            select_nibble = nibble_cmp4 ? old_nibble : newnibble;
-            shift = (10 - select_nibble) & 15;
-            step2 = (step2 << 1) >> shift;
+                if (sub_phase_of >= 1)
+                    reference = addclip20(reference, shifted >> 1, shifted & 1);
 
-            int reg1 = ram1[1];
-            int reg3 = ram1[3];
-            int reg2_6 = (ram2[6] >> 8) & 127;
+                preshift = samp1 << 10;
+                select_nibble = nibble_cmp3 ? old_nibble : newnibble;
+                shift = (10 - select_nibble) & 15;
 
-            test = addclip20(test, step2 >> 1, step2 & 1);
+                shifted = (preshift << 1) >> shift;
 
-            int filter = ram2[11];
-            int v3;
+                if (sub_phase_of >= 2)
+                    reference = addclip20(reference, shifted >> 1, shifted & 1);
 
-            // if (mcu->mcu_mk1)
-            if (false) 
-            {
-                int mult1 = multi(reg1, filter >> 8); // 8
-                int mult2 = multi(reg1, (filter >> 1) & 127); // 9
-                int mult3 = multi(reg1, reg2_6); // 10
+                preshift = samp2 << 10;
+                select_nibble = nibble_cmp4 ? old_nibble : newnibble;
+                shift = (10 - select_nibble) & 15;
 
-                int v2 = addclip20(reg3, mult1 >> 6, (mult1 >> 5) & 1); // 9
-                int v1 = addclip20(v2, mult2 >> 13, (mult2 >> 12) & 1); // 10
-                int subvar = addclip20(v1, (mult3 >> 6), (mult3 >> 5) & 1); // 11
+                shifted = (preshift << 1) >> shift;
 
-                ram1[3] = v1;
+                if (sub_phase_of >= 3)
+                    reference = addclip20(reference, shifted >> 1, shifted & 1);
 
-                v3 = addclip20(test, subvar ^ 0xfffff, 1); // 12
+                preshift = samp3 << 10;
+                select_nibble = nibble_cmp5 ? old_nibble : newnibble;
+                shift = (10 - select_nibble) & 15;
 
-                int mult4 = multi(v3, filter >> 8);
-                int mult5 = multi(v3, (filter >> 1) & 127);
-                int v4 = addclip20(reg1, mult4 >> 6, (mult4 >> 5) & 1); // 14
-                int v5 = addclip20(v4, mult5 >> 13, (mult5 >> 12) & 1); // 15
+                shifted = (preshift << 1) >> shift;
 
-                ram1[1] = v5;
-            }
-            else
-            {
-                // hack: use 32-bit math to avoid overflow
-                int mult1 = reg1 * (int8_t)(filter >> 8); // 8
-                int mult2 = reg1 * (int8_t)((filter >> 1) & 127); // 9
-                int mult3 = reg1 * (int8_t)reg2_6; // 10
+                if (sub_phase_of >= 4)
+                    reference = addclip20(reference, shifted >> 1, shifted & 1);
 
-                int v2 = reg3 + (mult1 >> 6) + ((mult1 >> 5) & 1); // 9
-                int v1 = v2 + (mult2 >> 13) + ((mult2 >> 12) & 1); // 10
-                int subvar = v1 + (mult3 >> 6) + ((mult3 >> 5) & 1); // 11
+                // interpolation
 
-                ram1[3] = v1;
+                int test = ram1[5];
 
-                int tests = test;
-                tests <<= 12;
-                tests >>= 12;
+                int step0 = multi(interp_lut[0][interp_ratio] << 6, samp0) >> 8;
+                select_nibble = nibble_cmp2 ? old_nibble : newnibble;
+                shift = (10 - select_nibble) & 15;
+                step0 =  (step0 << 1) >> shift;
 
-                v3 = tests - subvar; // 12
+                test = addclip20(test, step0 >> 1, step0 & 1);
 
-                int mult4 = v3 * (int8_t)(filter >> 8);
-                int mult5 = v3 * (int8_t)((filter >> 1) & 127);
-                int v4 = reg1 + (mult4 >> 6) + ((mult4 >> 5) & 1); // 14
-                int v5 = v4 + (mult5 >> 13) + ((mult5 >> 12) & 1); // 15
 
-                ram1[1] = v5;
-            }
+                int step1 = multi(interp_lut[1][interp_ratio] << 6, samp1) >> 8;
+                select_nibble = nibble_cmp3 ? old_nibble : newnibble;
+                shift = (10 - select_nibble) & 15;
+                step1 = (step1 << 1) >> shift;
 
+                test = addclip20(test, step1 >> 1, step1 & 1);
 
-            ram1[5] = reference;
+                int step2 = multi(interp_lut[2][interp_ratio] << 6, samp2) >> 8;
+                select_nibble = nibble_cmp4 ? old_nibble : newnibble;
+                shift = (10 - select_nibble) & 15;
+                step2 = (step2 << 1) >> shift;
 
-            if (active && (ram2[6] & 1) != 0 && (ram2[8] & 0x4000) == 0 && !pcm.irq_assert && irq_flag)
-            {
-                //printf("irq voice %i\n", slot);
-                if (pcm.nfs)
-                    ram2[8] |= 0x4000;
-                pcm.irq_assert = 1;
-                pcm.irq_channel = slot;
-                mcu->MCU_GA_SetGAInt(5, 1);
-            }
+                int reg1 = ram1[1];
+                int reg3 = ram1[3];
+                int reg2_6 = (ram2[6] >> 8) & 127;
 
-            int volmul1 = 0;
-            int volmul2 = 0;
+                test = addclip20(test, step2 >> 1, step2 & 1);
 
-            calc_tv(&pcm, 0, ram2[3], &ram2[9], active, &volmul1);
-            calc_tv(&pcm, 1, ram2[4], &ram2[10], active, &volmul2);
-            calc_tv(&pcm, 2, ram2[5], &ram2[11], active, NULL);
+                int filter = ram2[11];
 
-            // if (volmul1 && volmul2)
-            //     volmul1 += 0;
+                ram1[5] = reference;
 
-            int sample = (ram2[6] & 2) == 0 ? ram1[3] : v3;
-            //sample = test;
+                lanes->irq[slot] = active && (ram2[6] & 1) != 0 && (ram2[8] & 0x4000) == 0 && irq_flag;
 
-            int multiv1 = multi(sample, volmul1 >> 8);
-            int multiv2 = multi(sample, (volmul1 >> 1) & 127);
+                int volmul1 = 0;
+                int volmul2 = 0;
 
-            int sample2 = addclip20(multiv1 >> 6, multiv2 >> 13, ((multiv2 >> 12) | (multiv1 >> 5)) & 1);
+                calc_tv(&pcm, 0, ram2[3], &ram2[9], active, &volmul1);
+                calc_tv(&pcm, 1, ram2[4], &ram2[10], active, &volmul2);
+                calc_tv(&pcm, 2, ram2[5], &ram2[11], active, NULL);
 
-            int multiv3 = multi(sample2, volmul2 >> 8);
-            int multiv4 = multi(sample2, (volmul2 >> 1) & 127);
+                lanes->test[slot] = test;
+                lanes->reg1[slot] = reg1;
+                lanes->reg3[slot] = reg3;
+                lanes->reg2_6[slot] = reg2_6;
+                lanes->filter[slot] = filter;
+                lanes->use_v3[slot] = (ram2[6] & 2) != 0 ? -1 : 0;
+                lanes->volmul1[slot] = volmul1;
+                lanes->volmul2[slot] = volmul2;
+                lanes->pan[slot] = active ? ram2[1] : 0;
+                lanes->rc[slot] = active ? ram2[2] : 0;
+                lanes->clear[slot] = !active && pcm.nfs;
 
-            int sample3 = addclip20(multiv3 >> 6, multiv4 >> 13, ((multiv4 >> 12) | (multiv3 >> 5)) & 1);
+                if (key && pcm.nfs)
+                {
+                    ram2[7] &= ~0xf020;
+                    ram2[7] |= ((usenew || kon) ? newnibble : old_nibble) << 12;
 
-            int pan = active ? ram2[1] : 0;
-            int rc = active ? ram2[2] : 0;
+                    // update key
+                    ram2[7] |= key << 5;
+                }
 
-            int sampl = multi(sample3, (pan >> 8) & 255);
-            int sampr = multi(sample3, (pan >> 0) & 255);
+                if (!active)
+                {
+                    if (pcm.nfs)
+                        ram1[5] = 0;
 
-            int rc0 = multi(sample3, (rc >> 8) & 255) >> 5; // reverb
-            int rc1 = multi(sample3, (rc >> 0) & 255) >> 5; // chorus
+                    ram2[8] = 0;
+                    ram2[9] = 0;
+                    ram2[10] = 0;
+                }
+            }
 
-            // sampl_per_slot[slot] = sampl;
-            // sampr_per_slot[slot] = sampr;
-            // rc0_per_slot[slot] = rc0;
-            // rc1_per_slot[slot] = rc1;
+            PCM_VoiceBackEnd(lanes, batch_start, batch_end);
 
-            if (key && pcm.nfs)
+            for (int slot = batch_start; slot < batch_end; slot++)
             {
-                ram2[7] &= ~0xf020;
-                ram2[7] |= ((usenew || kon) ? newnibble : old_nibble) << 12;
-
-                // update key
-                ram2[7] |= key << 5;
-            }
+                uint32_t *ram1 = pcm.ram1[slot];
+                uint16_t *ram2 = pcm.ram2[slot];
 
-            if (!active)
-            {
-                if (pcm.nfs)
+                ram1[3] = lanes->v1[slot];
+                ram1[1] = lanes->v5[slot];
+                if (lanes->clear[slot])
                 {
                     ram1[1] = 0;
                     ram1[3] = 0;
-                    ram1[5] = 0;
                 }
 
-                ram2[8] = 0;
-                ram2[9] = 0;
-                ram2[10] = 0;
-            }
-        // }
-            
-        // for (int slot = 0; slot < reg_slots; slot++)
-        // {
-        //     int sampl = sampl_per_slot[slot];
-        //     int sampr = sampr_per_slot[slot];
-        //     int rc0 = rc0_per_slot[slot];
-        //     int rc1 = rc1_per_slot[slot];
-
-            // mix reverb/chorus?
-            int next_slot = (slot == reg_slots - 1) ? 31 : slot + 1;
-            switch (next_slot)
-            {
-                // 17, 18 - reverb
-
-                case 17: {
-                    pcm.ram1[31][1] = addclip20(pcm.ram1[31][1], rcadd[0] >> 1, rcadd[0] & 1);
-                    pcm.rcsum[1] = addclip20(pcm.rcsum[1], rcadd2[0] >> 1, rcadd2[0] & 1);
-                    break;
-                }
-                case 18: {
-                    pcm.ram1[31][3] = addclip20(pcm.ram1[31][3], rcadd[1] >> 1, rcadd[1] & 1);
-                    pcm.rcsum[1] = addclip20(pcm.rcsum[1], rcadd2[1] >> 1, rcadd2[1] & 1);
-                    break;
-                }
-                case 21: {
-                    pcm.ram1[31][1] = addclip20(pcm.ram1[31][1], rcadd[2] >> 1, rcadd[2] & 1);
-                    pcm.rcsum[0] = addclip20(pcm.rcsum[0], rcadd2[2] >> 1, rcadd2[2] & 1);
-                    break;
-                }
-                case 22: {
-                    pcm.ram1[31][3] = addclip20(pcm.ram1[31][3], rcadd[3] >> 1, rcadd[3] & 1);
-                    pcm.rcsum[1] = addclip20(pcm.rcsum[1], rcadd2[3] >> 1, rcadd2[3] & 1);
-                    break;
-                }
-                case 23: {
-                    pcm.ram1[31][1] = addclip20(pcm.ram1[31][1], rcadd[4] >> 1, rcadd[4] & 1);
-                    pcm.rcsum[0] = addclip20(pcm.rcsum[0], rcadd2[4] >> 1, rcadd2[4] & 1);
-                    break;
+                if (lanes->irq[slot] && !pcm.irq_assert)
+                {
+                    //printf("irq voice %i\n", slot);
+                    if (pcm.nfs)
+                        ram2[8] |= 0x4000;
+                    pcm.irq_assert = 1;
+                    pcm.irq_channel = slot;
+                    mcu->MCU_GA_SetGAInt(5, 1);
                 }
-                case 31: {
-                    pcm.ram1[31][3] = addclip20(pcm.ram1[31][3], rcadd[5] >> 1, rcadd[5] & 1);
-                    pcm.rcsum[1] = addclip20(pcm.rcsum[1], rcadd2[5] >> 1, rcadd2[5] & 1);
-                    break;
+
+                int sampl = lanes->sampl[slot];
+                int sampr = lanes->sampr[slot];
+                int rc0 = lanes->rc0[slot];
+                int rc1 = lanes->rc1[slot];
+
+                // mix reverb/chorus?
+                int next_slot = (slot == reg_slots - 1) ? 31 : slot + 1;
+                switch (next_slot)
+                {
+                    // 17, 18 - reverb
+
+                    case 17: {
+                        pcm.ram1[31][1] = addclip20(pcm.ram1[31][1], rcadd[0] >> 1, rcadd[0] & 1);
+                        pcm.rcsum[1] = addclip20(pcm.rcsum[1], rcadd2[0] >> 1, rcadd2[0] & 1);
+                        break;
+                    }
+                    case 18: {
+                        pcm.ram1[31][3] = addclip20(pcm.ram1[31][3], rcadd[1] >> 1, rcadd[1] & 1);
+                        pcm.rcsum[1] = addclip20(pcm.rcsum[1], rcadd2[1] >> 1, rcadd2[1] & 1);
+                        break;
+                    }
+                    case 21: {
+                        pcm.ram1[31][1] = addclip20(pcm.ram1[31][1], rcadd[2] >> 1, rcadd[2] & 1);
+                        pcm.rcsum[0] = addclip20(pcm.rcsum[0], rcadd2[2] >> 1, rcadd2[2] & 1);
+                        break;
+                    }
+                    case 22: {
+                        pcm.ram1[31][3] = addclip20(pcm.ram1[31][3], rcadd[3] >> 1, rcadd[3] & 1);
+                        pcm.rcsum[1] = addclip20(pcm.rcsum[1], rcadd2[3] >> 1, rcadd2[3] & 1);
+                        break;
+                    }
+                    case 23: {
+                        pcm.ram1[31][1] = addclip20(pcm.ram1[31][1], rcadd[4] >> 1, rcadd[4] & 1);
+                        pcm.rcsum[0] = addclip20(pcm.rcsum[0], rcadd2[4] >> 1, rcadd2[4] & 1);
+                        break;
+                    }
+                    case 31: {
+                        pcm.ram1[31][3] = addclip20(pcm.ram1[31][3], rcadd[5] >> 1, rcadd[5] & 1);
+                        pcm.rcsum[1] = addclip20(pcm.rcsum[1], rcadd2[5] >> 1, rcadd2[5] & 1);
+                        break;
+                    }
                 }
-            }
 
-            pcm.rcsum[0] = addclip20(pcm.rcsum[0], rc0 >> 1, rc0 & 1);
-            pcm.rcsum[1] = addclip20(pcm.rcsum[1], rc1 >> 1, rc1 & 1);
+                pcm.rcsum[0] = addclip20(pcm.rcsum[0], rc0 >> 1, rc0 & 1);
+                pcm.rcsum[1] = addclip20(pcm.rcsum[1], rc1 >> 1, rc1 & 1);
 
-            int suml = addclip20(pcm.ram1[31][1], sampl >> 6, (sampl >> 5) & 1);
-            int sumr = addclip20(pcm.ram1[31][3], sampr >> 6, (sampr >> 5) & 1);
-            if (slot != reg_slots - 1)
-            {
-                pcm.ram1[31][1] = suml;
-                pcm.ram1[31][3] = sumr;
-            }
-            else
-            {
-                pcm.accum_l = suml;
-                pcm.accum_r = sumr;
+                int suml = addclip20(pcm.ram1[31][1], sampl >> 6, (sampl >> 5) & 1);
+                int sumr = addclip20(pcm.ram1[31][3], sampr >> 6, (sampr >> 5) & 1);
+                if (slot != reg_slots - 1)
+                {
+                    pcm.ram1[31][1] = suml;
+                    pcm.ram1[31][3] = sumr;
+                }
+                else
+                {
+                    pcm.accum_l = suml;
+                    pcm.accum_r = sumr;
+                }
             }
         }
 
@@ -1419,7 +1682,13 @@ void Pcm::PCM_Update(uint64_t cycles)
 
         pcm.nfs = 1;
 
-        const int cycles = (reg_slots + 1) * 25;
-        pcm.cycles += (cycles * 25) / 29;
+        pcm.cycles += frame_cycles;
+    }
+
+    if (pcm.cycles != start_cycles)
+    {
+        meter_raise(&meter.out_peak, out_peak);
+        uint32_t slot_mask = reg_slots == 32 ? ~0u : (1u << reg_slots) - 1;
+        meter_voices(&meter, &pcm, voice_active & slot_mask);
     }
 }
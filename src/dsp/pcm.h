@@ -34,6 +34,7 @@
 #pragma once
 #include <stdint.h>
 #include <pthread.h>
+#include <atomic>
 
 struct pcm_t {
   uint32_t ram1[32][8];
@@ -64,6 +65,62 @@ struct pcm_t {
   int rcsum[2];
 };
 
+// Structure-of-arrays view of the voice slots for one frame. The scalar
+// part of PCM_Update fills the inputs per slot; the filter, volume and
+// pan/send stage then runs a vector of slots at a time. Arrays are padded
+// so the last vector can run past slot 31.
+static const int PCM_VOICE_LANES = 36;
+
+struct pcm_voice_lanes_t {
+  int32_t test[PCM_VOICE_LANES];   // interpolated sample
+  int32_t reg1[PCM_VOICE_LANES];   // filter state, ram1[1]
+  int32_t reg3[PCM_VOICE_LANES];   // filter state, ram1[3]
+  int32_t reg2_6[PCM_VOICE_LANES]; // resonance
+  int32_t filter[PCM_VOICE_LANES]; // cutoff envelope, ram2[11]
+  int32_t use_v3[PCM_VOICE_LANES]; // -1 = highpass output
+  int32_t volmul1[PCM_VOICE_LANES];
+  int32_t volmul2[PCM_VOICE_LANES];
+  int32_t pan[PCM_VOICE_LANES];
+  int32_t rc[PCM_VOICE_LANES];
+
+  int32_t v1[PCM_VOICE_LANES];
+  int32_t v5[PCM_VOICE_LANES];
+  int32_t sampl[PCM_VOICE_LANES];
+  int32_t sampr[PCM_VOICE_LANES];
+  int32_t rc0[PCM_VOICE_LANES];
+  int32_t rc1[PCM_VOICE_LANES];
+
+  uint8_t irq[32];   // slot may raise the voice IRQ
+  uint8_t clear[32]; // slot is off, zero its filter state
+};
+
+// eram decoded for the reverb/chorus taps: each word's 14-bit mantissa
+// and 2-bit exponent expanded to the value a tap reads, so a read is a
+// plain load. Derived from pcm_t::eram and written alongside it.
+struct pcm_eram_shadow_t {
+  int32_t dec[0x4000];
+  uint32_t nonzero; // nonzero words in eram
+};
+
+// Voice activity and output level for metering, kept by PCM_Update. The
+// peaks hold until the reader lowers them with exchange; PCM_Update only
+// ever raises them, so a reset from another thread is never lost.
+struct pcm_meter_t {
+  std::atomic<uint32_t> active_mask; // slots keyed in the last rendered frame
+  std::atomic<int> active_peak;      // most slots keyed in one frame
+  std::atomic<uint16_t> level[32];   // TVA envelopes (ram2[9] * ram2[10]), 0-16129
+  std::atomic<int> out_peak;         // largest |sample| posted, int16 scale
+};
+
+// Output rate: oversampled posts two samples per frame (64 kHz, the
+// default), native follows the chip's oversampling bit (config_reg_3c
+// bit 6) and single posts one (32 kHz).
+enum {
+  PCM_OUTPUT_OVERSAMPLED,
+  PCM_OUTPUT_NATIVE,
+  PCM_OUTPUT_SINGLE,
+};
+
 struct MCU;
 
 struct Pcm {
@@ -75,31 +132,85 @@ struct Pcm {
   uint8_t waverom2[0x200000];
   uint8_t waverom3[0x100000];
   uint8_t waverom_card[0x200000];
-  uint8_t waverom_exp[0x800000];
 
+  // Wave address bits 21-23 select one of eight 2 MB banks: 0-1 internal
+  // wave ROM, 2 card, 3-6 expansion board. Banks are mapped by pointer so
+  // a fetch is a single indexed load and an expansion can be swapped in
+  // without copying; unmapped banks read from a shared zero bank.
+  static const uint32_t WAVE_BANK_SIZE = 0x200000;
+  const uint8_t *wave_bank[8];
+
+  pcm_voice_lanes_t voice_lanes = {};
+
+  // Slots with their IRQ enable bit (ram2[6] bit 0) set, derived from pcm
+  uint32_t irq_enable_mask = 0;
+
+  int output_mode = PCM_OUTPUT_OVERSAMPLED;
+
+  pcm_eram_shadow_t eram_shadow = {};
+
+  pcm_meter_t meter = {};
+
+  // Voice governor: with voice_limit below 32 at most that many slots are
+  // rendered. Excess slots are stolen, the quietest first, and stay silent
+  // until the firmware keys them off or starts a new note on them. Slots
+  // with an IRQ enable are never stolen, as the firmware waits on those.
+  int voice_limit = 32;
+  std::atomic<uint32_t> voice_stolen{0}; // also read by the plugin's get_param
+  uint64_t voice_onset[32] = {}; // pcm.cycles when the note started
 
   void PCM_Write(uint32_t address, uint8_t data);
   uint8_t PCM_Read(uint32_t address);
   void PCM_Reset(void);
+  void PCM_ResetVoiceSteal(void);
   void PCM_Update(uint64_t cycles);
+  void PCM_UpdateIrqMask(void);
+  void PCM_UpdateEramShadow(void);
+  void PCM_ReverbChorus(int *rcadd, int *rcadd2);
+  uint32_t PCM_StealVoices(uint32_t active);
 
-  inline uint8_t PCM_ReadROM(const uint32_t address) {
-    int bank = (address >> 21) & 7;
-    switch (bank) {
-    case 0:
-      return waverom1[address & 0x1fffff];
-    case 1:
-      return waverom2[address & 0x1fffff];
-    case 2:
-      return waverom_card[address & 0x1fffff];
-    case 3:
-    case 4:
-    case 5:
-    case 6:
-      return waverom_exp[(address & 0x1fffff) + (bank - 3) * 0x200000];
-    default:
-      break;
+  // With the delay lines drained (every eram word zero), zero sends and the
+  // network's registers in slots 28/29 clear, the reverb/chorus stage maps
+  // its state onto itself and adds nothing to the mix.
+  inline bool PCM_EffectsIdle() const {
+    if (eram_shadow.nonzero || pcm.rcsum[0] || pcm.rcsum[1])
+      return false;
+    for (int i = 0; i < 6; i++) {
+      if (pcm.ram1[28][i] | pcm.ram1[29][i])
+        return false;
     }
-    return 0;
+    return true;
+  }
+
+  // Interleaved values posted per frame: 4 oversampled, 2 single rate
+  inline int PCM_FrameSamples() const {
+    if (output_mode == PCM_OUTPUT_NATIVE)
+      return (pcm.config_reg_3c & 0x40) ? 4 : 2;
+    return output_mode == PCM_OUTPUT_SINGLE ? 2 : 4;
+  }
+
+  // MCU cycles taken by one frame
+  static inline uint64_t PCM_FrameCycles(const uint8_t config_reg_3d) {
+    const int reg_slots = (config_reg_3d & 31) + 1;
+    const int cycles = (reg_slots + 1) * 25;
+    return (cycles * 25) / 29;
+  }
+
+  // A voice IRQ can only be raised by a keyed slot with IRQ enabled, and
+  // only while the previous one has been acknowledged.
+  inline bool PCM_IrqPossible() {
+    return !pcm.irq_assert &&
+           (pcm.voice_mask & pcm.voice_mask_pending & irq_enable_mask) != 0;
+  }
+
+  // data must stay valid until the bank is remapped; nullptr unmaps it
+  void PCM_MapWaveBank(int bank, const uint8_t *data);
+
+  inline uint8_t PCM_ReadROM(const uint32_t address) {
+    return wave_bank[(address >> 21) & 7][address & 0x1fffff];
+  }
+
+  inline void PCM_PrefetchROM(const uint32_t address) {
+    __builtin_prefetch(&wave_bank[(address >> 21) & 7][address & 0x1fffff]);
   }
 };
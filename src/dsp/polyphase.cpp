@@ -0,0 +1,172 @@
+/*
+ * Stereo polyphase resampler, see polyphase.h
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "polyphase.h"
+
+// -6 dB at 21.15 kHz for 64 kHz input: flat to 18 kHz, and the aliases that
+// would fold below 20 kHz (input above 24.1 kHz) are in the stopband
+const PolyphaseResampler::Quality PolyphaseResampler::QUALITY[3] = {
+    {"fast", 24, 3.6, 0.959},
+    {"standard", 32, 5.0, 0.959},
+    {"high", 48, 7.3, 0.959},
+};
+
+// Two stereo frames per vector: L0 R0 L1 R1 against c0 c0 c1 c1
+typedef float ps_v4f __attribute__((vector_size(16)));
+
+static inline ps_v4f v_loadf(const float *p)
+{
+    ps_v4f v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Zeroth-order modified Bessel function for the Kaiser window
+static double bessel_i0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+bool PolyphaseResampler::Init(int quality)
+{
+    Free();
+    taps = QUALITY[quality].taps;
+    beta = QUALITY[quality].beta;
+    cutoff = QUALITY[quality].cutoff;
+    history = (float *)malloc((taps - 1 + MAX_BLOCK) * 2 * sizeof(float));
+    if (!history)
+        return false;
+    in_rate = 0;
+    Reset();
+    return true;
+}
+
+void PolyphaseResampler::Free()
+{
+    free(coefs);
+    free(history);
+    coefs = NULL;
+    history = NULL;
+    in_rate = 0;
+}
+
+void PolyphaseResampler::Reset()
+{
+    memset(history, 0, (taps - 1) * 2 * sizeof(float));
+    history_len = taps - 1;
+    pos = taps - 1;
+    phase = 0;
+}
+
+// Kaiser-windowed sinc at UP * rate, split into UP phases of `taps`. The
+// input's IN_BITS full scale is folded into the coefficients.
+bool PolyphaseResampler::Build(int rate)
+{
+    const int n = UP * taps;
+    double *h = (double *)malloc(n * sizeof(double));
+    float *c = (float *)malloc(n * 2 * sizeof(float));
+    if (!h || !c)
+    {
+        free(h);
+        free(c);
+        return false;
+    }
+
+    const double nyquist = 0.5 * (rate < OUT_RATE ? rate : OUT_RATE);
+    const double fc = cutoff * nyquist / ((double)rate * UP);
+    const double centre = 0.5 * (n - 1);
+    const double half = 0.5 * n;
+    const double ibeta = 1.0 / bessel_i0(beta);
+    double sum = 0.0;
+    for (int m = 0; m < n; m++)
+    {
+        double x = m - centre;
+        double s = x == 0.0 ? 2.0 * fc : sin(2.0 * M_PI * fc * x) / (M_PI * x);
+        double r = x / half;
+        h[m] = s * bessel_i0(beta * sqrt(1.0 - r * r)) * ibeta;
+        sum += h[m];
+    }
+
+    const double scale = UP / sum / (double)(1 << (IN_BITS - 1));
+    for (int p = 0; p < UP; p++)
+    {
+        float *cp = c + p * taps * 2;
+        for (int j = 0; j < taps; j++)
+        {
+            float v = (float)(h[(taps - 1 - j) * UP + p] * scale);
+            cp[j * 2 + 0] = v;
+            cp[j * 2 + 1] = v;
+        }
+    }
+    free(h);
+
+    free(coefs);
+    coefs = c;
+    in_rate = rate;
+    down = rate / 100;
+    Reset();
+    return true;
+}
+
+int PolyphaseResampler::Process(const int32_t *in, int frames, int rate,
+                                float *out, int max_out)
+{
+    if (!history || (rate != in_rate && !Build(rate)))
+        return 0;
+
+    const int space = taps - 1 + MAX_BLOCK - history_len;
+    if (frames > space)
+        frames = space;
+    float *h = history + history_len * 2;
+    for (int i = 0; i < frames * 2; i++)
+        h[i] = (float)in[i];
+    history_len += frames;
+
+    const int len = taps * 2;
+    int written = 0;
+    while (pos < history_len && written < max_out)
+    {
+        const float *x = history + (pos - taps + 1) * 2;
+        const float *c = coefs + phase * len;
+        ps_v4f acc0 = {0, 0, 0, 0};
+        ps_v4f acc1 = {0, 0, 0, 0};
+        int j = 0;
+        for (; j + 8 <= len; j += 8)
+        {
+            acc0 += v_loadf(x + j) * v_loadf(c + j);
+            acc1 += v_loadf(x + j + 4) * v_loadf(c + j + 4);
+        }
+        if (j < len)
+            acc0 += v_loadf(x + j) * v_loadf(c + j);
+        acc0 += acc1;
+        out[written * 2 + 0] = acc0[0] + acc0[2];
+        out[written * 2 + 1] = acc0[1] + acc0[3];
+        written++;
+
+        phase += down;
+        pos += phase / UP;
+        phase %= UP;
+    }
+
+    // Keep the taps - 1 frames the next output looks back on
+    const int drop = pos - (taps - 1);
+    if (drop > 0)
+    {
+        memmove(history, history + drop * 2, (history_len - drop) * 2 * sizeof(float));
+        history_len -= drop;
+        pos -= drop;
+    }
+    return written;
+}
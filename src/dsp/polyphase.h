@@ -0,0 +1,53 @@
+/*
+ * Stereo polyphase resampler for the core's fixed output rates
+ *
+ * The PCM runs at 64000 Hz (32000 Hz in single-rate output mode) and the
+ * host at 44100 Hz, so the ratio is the rational 441/640 (441/320). Each
+ * of the 441 output phases gets its own precomputed coefficient bank, and
+ * the input is taken straight from MCU::sample_buffer (interleaved 20-bit
+ * samples in int32).
+ */
+#pragma once
+#include <stdint.h>
+
+struct PolyphaseResampler {
+  static const int OUT_RATE = 44100;
+  static const int UP = 441;           // OUT_RATE / 100
+  static const int MAX_BLOCK = 4096;   // input frames per Process call
+  static const int IN_BITS = 20;       // audio_sample_bits in mcu.h
+
+  // Taps per phase, Kaiser window beta and -6 dB point as a fraction of
+  // the lower Nyquist rate; see bench_core for the resulting table
+  struct Quality {
+    const char *name;
+    int taps; // multiple of 2
+    double beta;
+    double cutoff;
+  };
+  static const Quality QUALITY[3]; // fast, standard, high
+  static const int DEFAULT_QUALITY = 2;
+
+  int taps;
+  double beta;
+  double cutoff;
+  int in_rate; // 0 until the first Process call
+  int down;    // in_rate / 100
+  float *coefs;   // [UP][taps * 2]: each phase reversed, taps duplicated for L/R
+  float *history; // interleaved stereo, (taps - 1 + MAX_BLOCK) frames
+  int history_len; // frames in history
+  int pos;         // history frame of the next output
+  int phase;       // its phase, 0 .. UP - 1
+
+  // Zero-initialised (calloc) instances are valid before Init
+  bool Init(int quality);
+  void Free();
+  void Reset();
+
+  // Resamples up to MAX_BLOCK interleaved IN_BITS stereo frames at in_rate
+  // into interleaved float frames, full scale 1.0, and returns the frames
+  // written. Input not yet used is kept for the next call. A change of
+  // in_rate rebuilds the banks and restarts from silence.
+  int Process(const int32_t *in, int frames, int in_rate, float *out, int max_out);
+
+  bool Build(int rate);
+};
@@ -0,0 +1,380 @@
+/*
+ * Headless benchmark for the emulator core (MCU + PCM, no plugin)
+ *
+ * Boots from ROMs on disk, runs the same warmup as the plugin, then plays a
+ * fixed MIDI script in 64-sample blocks like the plugin's emu thread.
+ * Prints throughput, per-phase timings and a hash of the rendered audio as
+ * JSON. The hash only depends on the ROMs and the script, so two runs (or
+ * two builds that are meant to be bit-exact) must print the same value.
+ *
+ * The "resampler" table compares the 64 kHz -> 44.1 kHz resampler presets
+ * with the libresample setup the plugin used before: cost per output
+ * frame, worst alias level for a 24.3-31.9 kHz sweep (which folds into the
+ * passband) and the passband gain error at 1, 10 and 18 kHz.
+ *
+ * --trace FILE writes every interrupt the MCU takes (cycle, vector, pc, sr)
+ * and the cycle count and sample count after every block. The trace is as
+ * deterministic as the hash, so diffing it between two builds shows the
+ * first instruction where their timing differs.
+ *
+ * Build: make bench_core
+ * Run:   ./bench_core ../roms [seconds] [--trace FILE]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <math.h>
+#include <time.h>
+#include "mcu.h"
+#include "polyphase.h"
+#include "libresample.h"
+
+// Output rate the plugin assumes for the core, see JV880_SAMPLE_RATE
+static const int CORE_SAMPLE_RATE = 64000;
+static const int WARMUP_STEPS = 100000;
+static const int BLOCK_SAMPLES = 64; // interleaved, as in v2_emu_thread_func
+
+static uint8_t* load_file(const char* path, size_t size, bool required) {
+    uint8_t* data = new uint8_t[size];
+    memset(data, 0xff, size);
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        if (required) {
+            fprintf(stderr, "Error: Cannot open %s\n", path);
+            delete[] data;
+            return nullptr;
+        }
+        return data;
+    }
+    size_t read = fread(data, 1, size, f);
+    fclose(f);
+    if (read != size && required) {
+        fprintf(stderr, "Error: %s is %zu bytes (expected %zu)\n", path, read, size);
+        delete[] data;
+        return nullptr;
+    }
+    return data;
+}
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// FNV-1a 64 over the rendered samples
+static uint64_t hash_update(uint64_t h, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Scripted performance: one event list per 2-second bar, repeated. Times
+// are in blocks of BLOCK_SAMPLES / 2 frames (0.5 ms at 64 kHz).
+struct ScriptEvent {
+    int block;
+    uint8_t msg[3];
+    int len;
+};
+
+static const ScriptEvent SCRIPT[] = {
+    {0,    {0xC0, 0x00, 0x00}, 2},  // patch 1
+    {0,    {0xB0, 0x07, 0x64}, 3},
+    {10,   {0x90, 0x30, 0x64}, 3},  // C major chord
+    {10,   {0x90, 0x34, 0x5a}, 3},
+    {10,   {0x90, 0x37, 0x50}, 3},
+    {10,   {0x90, 0x3c, 0x48}, 3},
+    {500,  {0xB0, 0x01, 0x40}, 3},  // mod wheel
+    {900,  {0x80, 0x30, 0x00}, 3},
+    {900,  {0x80, 0x34, 0x00}, 3},
+    {900,  {0x80, 0x37, 0x00}, 3},
+    {900,  {0x80, 0x3c, 0x00}, 3},
+    {1000, {0xB0, 0x01, 0x00}, 3},
+    {1000, {0x90, 0x24, 0x7f}, 3},  // bass line plus arpeggio
+    {1250, {0x90, 0x43, 0x60}, 3},
+    {1375, {0x80, 0x43, 0x00}, 3},
+    {1375, {0x90, 0x48, 0x60}, 3},
+    {1500, {0x80, 0x48, 0x00}, 3},
+    {1500, {0x90, 0x4c, 0x60}, 3},
+    {1625, {0x80, 0x4c, 0x00}, 3},
+    {1625, {0xE0, 0x00, 0x50}, 3},  // pitch bend up
+    {1750, {0xE0, 0x00, 0x40}, 3},
+    {1900, {0x80, 0x24, 0x00}, 3},
+};
+static const int SCRIPT_LEN = sizeof(SCRIPT) / sizeof(SCRIPT[0]);
+static const int SCRIPT_BAR_BLOCKS = 4000;
+
+static const float RS_FULL_SCALE = (float)(1 << (audio_sample_bits - 1));
+
+// Resampler under test: interleaved stereo core samples in (see
+// audio_sample_bits), interleaved float out.
+// quality < 0 selects libresample, one instance per channel as the plugin had.
+struct ResamplerUnderTest {
+    const char* name;
+    int quality;
+    int taps; // input frames under the filter, set by rut_open
+    PolyphaseResampler poly;
+    void* lib[2];
+    float lib_in[2][PolyphaseResampler::MAX_BLOCK];
+    float lib_out[2][PolyphaseResampler::MAX_BLOCK];
+};
+
+static void rut_open(ResamplerUnderTest* r) {
+    if (r->quality >= 0) {
+        memset(&r->poly, 0, sizeof(r->poly));
+        r->poly.Init(r->quality);
+        r->taps = r->poly.taps;
+        return;
+    }
+    double ratio = (double)PolyphaseResampler::OUT_RATE / CORE_SAMPLE_RATE;
+    for (int c = 0; c < 2; c++)
+        r->lib[c] = resample_open(1, ratio, ratio);
+    r->taps = 2 * resample_get_filter_width(r->lib[0]);
+}
+
+static void rut_close(ResamplerUnderTest* r) {
+    if (r->quality >= 0) {
+        r->poly.Free();
+        return;
+    }
+    for (int c = 0; c < 2; c++)
+        resample_close(r->lib[c]);
+}
+
+static int rut_process(ResamplerUnderTest* r, const int32_t* in, int frames, float* out, int max_out) {
+    if (r->quality >= 0)
+        return r->poly.Process(in, frames, CORE_SAMPLE_RATE, out, max_out);
+
+    double ratio = (double)PolyphaseResampler::OUT_RATE / CORE_SAMPLE_RATE;
+    int n = max_out;
+    for (int c = 0; c < 2; c++) {
+        for (int i = 0; i < frames; i++)
+            r->lib_in[c][i] = in[i * 2 + c] / RS_FULL_SCALE;
+        int used = 0;
+        int got = resample_process(r->lib[c], ratio, r->lib_in[c], frames, 0, &used,
+                                   r->lib_out[c], max_out);
+        if (got < n)
+            n = got;
+    }
+    for (int i = 0; i < n; i++) {
+        out[i * 2 + 0] = r->lib_out[0][i];
+        out[i * 2 + 1] = r->lib_out[1][i];
+    }
+    return n;
+}
+
+static const int RS_BLOCK = 64;            // input frames per call
+static const int RS_SKIP = 4096;           // output frames to settle
+static const int RS_WINDOW = 32768;        // output frames analysed
+static const double RS_AMPLITUDE = 0.5;
+
+// Level of freq_out in the resampled output of a sine at freq_in, in dB
+// relative to the input sine (Hann-windowed single-bin DFT)
+static double rs_tone_db(ResamplerUnderTest* r, double freq_in, double freq_out) {
+    const int out_frames = RS_SKIP + RS_WINDOW;
+    const int in_frames = (int)((double)out_frames * CORE_SAMPLE_RATE / PolyphaseResampler::OUT_RATE) + 1024;
+    int32_t* in = new int32_t[in_frames * 2];
+    float* out = new float[(out_frames + PolyphaseResampler::MAX_BLOCK) * 2];
+    for (int i = 0; i < in_frames; i++) {
+        int32_t v = (int32_t)lrint(RS_FULL_SCALE * RS_AMPLITUDE * sin(2.0 * M_PI * freq_in * i / CORE_SAMPLE_RATE));
+        in[i * 2 + 0] = v;
+        in[i * 2 + 1] = v;
+    }
+
+    rut_open(r);
+    int got = 0;
+    for (int i = 0; i + RS_BLOCK <= in_frames && got < out_frames; i += RS_BLOCK)
+        got += rut_process(r, in + i * 2, RS_BLOCK, out + got * 2, PolyphaseResampler::MAX_BLOCK);
+    rut_close(r);
+
+    double re = 0.0, im = 0.0, wsum = 0.0;
+    for (int i = 0; i < RS_WINDOW; i++) {
+        double w = 0.5 - 0.5 * cos(2.0 * M_PI * i / RS_WINDOW);
+        double ph = 2.0 * M_PI * freq_out * i / PolyphaseResampler::OUT_RATE;
+        double x = out[(RS_SKIP + i) * 2];
+        re += w * x * cos(ph);
+        im -= w * x * sin(ph);
+        wsum += w;
+    }
+    double amp = 2.0 * sqrt(re * re + im * im) / wsum;
+    delete[] in;
+    delete[] out;
+    return 20.0 * log10(amp / RS_AMPLITUDE + 1e-12);
+}
+
+// Wall time per output frame for a few seconds of a two-tone signal
+static double rs_ns_per_frame(ResamplerUnderTest* r) {
+    const int in_frames = CORE_SAMPLE_RATE * 4;
+    int32_t* in = new int32_t[in_frames * 2];
+    float* out = new float[PolyphaseResampler::MAX_BLOCK * 2];
+    for (int i = 0; i < in_frames; i++) {
+        double t = (double)i / CORE_SAMPLE_RATE;
+        in[i * 2 + 0] = (int32_t)(RS_FULL_SCALE * (0.25 * sin(2.0 * M_PI * 440.0 * t) + 0.12 * sin(2.0 * M_PI * 5100.0 * t)));
+        in[i * 2 + 1] = (int32_t)(RS_FULL_SCALE * (0.25 * sin(2.0 * M_PI * 660.0 * t) + 0.12 * sin(2.0 * M_PI * 7300.0 * t)));
+    }
+
+    rut_open(r);
+    uint64_t frames = 0;
+    double t0 = now_sec();
+    for (int i = 0; i + RS_BLOCK <= in_frames; i += RS_BLOCK)
+        frames += rut_process(r, in + i * 2, RS_BLOCK, out, PolyphaseResampler::MAX_BLOCK);
+    double t1 = now_sec();
+    rut_close(r);
+
+    delete[] in;
+    delete[] out;
+    return frames ? (t1 - t0) * 1e9 / frames : 0.0;
+}
+
+static void print_resampler_table() {
+    static ResamplerUnderTest r;
+    static const double PASSBAND_HZ[] = {1000.0, 10000.0, 18000.0};
+    const int count = 4;
+
+    printf("  \"resampler\": [\n");
+    for (int k = 0; k < count; k++) {
+        memset(&r, 0, sizeof(r));
+        r.quality = k < 3 ? k : -1;
+        r.name = k < 3 ? PolyphaseResampler::QUALITY[k].name : "libresample";
+
+        double ns_per_frame = rs_ns_per_frame(&r);
+        double alias_db = -200.0;
+        for (double f = 24300.0; f <= 31900.0; f += 400.0) {
+            double db = rs_tone_db(&r, f, PolyphaseResampler::OUT_RATE - f);
+            if (db > alias_db)
+                alias_db = db;
+        }
+        double ripple_db = 0.0;
+        for (int i = 0; i < 3; i++) {
+            double db = fabs(rs_tone_db(&r, PASSBAND_HZ[i], PASSBAND_HZ[i]));
+            if (db > ripple_db)
+                ripple_db = db;
+        }
+
+        printf("    {\"name\": \"%s\", \"taps\": %d, \"ns_per_frame\": %.1f, "
+               "\"alias_db\": %.1f, \"passband_error_db\": %.3f}%s\n",
+               r.name, r.taps, ns_per_frame, alias_db, ripple_db, k + 1 < count ? "," : "");
+    }
+    printf("  ],\n");
+}
+
+int main(int argc, char** argv) {
+    const char* roms_dir = nullptr;
+    double seconds = 10.0;
+    const char* trace_path = nullptr;
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            trace_path = argv[++i];
+        else if (positional == 0 && ++positional)
+            roms_dir = argv[i];
+        else if (positional == 1 && ++positional)
+            seconds = atof(argv[i]);
+    }
+    if (!roms_dir) {
+        fprintf(stderr, "Usage: %s <roms_dir> [seconds] [--trace FILE]\n", argv[0]);
+        return 1;
+    }
+    char path[512];
+
+    FILE* trace = nullptr;
+    if (trace_path) {
+        trace = fopen(trace_path, "w");
+        if (!trace) {
+            fprintf(stderr, "Error: Cannot write %s\n", trace_path);
+            return 1;
+        }
+    }
+
+    // Phase: load
+    double t0 = now_sec();
+
+    snprintf(path, sizeof(path), "%s/jv880_rom1.bin", roms_dir);
+    uint8_t* rom1 = load_file(path, ROM1_SIZE, true);
+    snprintf(path, sizeof(path), "%s/jv880_rom2.bin", roms_dir);
+    uint8_t* rom2 = load_file(path, ROM2_SIZE, true);
+    snprintf(path, sizeof(path), "%s/jv880_waverom1.bin", roms_dir);
+    uint8_t* waverom1 = load_file(path, 0x200000, true);
+    snprintf(path, sizeof(path), "%s/jv880_waverom2.bin", roms_dir);
+    uint8_t* waverom2 = load_file(path, 0x200000, true);
+    snprintf(path, sizeof(path), "%s/jv880_nvram.bin", roms_dir);
+    uint8_t* nvram = load_file(path, NVRAM_SIZE, false); // optional
+    if (!rom1 || !rom2 || !waverom1 || !waverom2)
+        return 1;
+
+    MCU* mcu = new MCU();
+    mcu->interrupt_trace = trace;
+    if (mcu->startSC55(rom1, rom2, waverom1, waverom2, nvram) != 0) {
+        fprintf(stderr, "Error: Failed to start emulator\n");
+        return 1;
+    }
+    mcu->nvram[NVRAM_MODE_OFFSET] = 1; // patch mode, as the plugin starts
+
+    // Phase: boot (same warmup as v2_load_thread_func)
+    double t1 = now_sec();
+    for (int i = 0; i < WARMUP_STEPS; i++)
+        mcu->updateSC55(1);
+    uint64_t boot_instructions = mcu->instruction_count;
+
+    // Phase: play
+    double t2 = now_sec();
+    const int total_blocks = (int)(seconds * CORE_SAMPLE_RATE / (BLOCK_SAMPLES / 2));
+    uint64_t hash = 1469598103934665603ull;
+    uint64_t frames = 0;
+    int next_event = 0;
+    for (int block = 0; block < total_blocks; block++) {
+        int bar_block = block % SCRIPT_BAR_BLOCKS;
+        if (bar_block == 0)
+            next_event = 0;
+        while (next_event < SCRIPT_LEN && SCRIPT[next_event].block == bar_block) {
+            mcu->postMidiSC55(SCRIPT[next_event].msg, SCRIPT[next_event].len);
+            next_event++;
+        }
+
+        mcu->updateSC55(BLOCK_SAMPLES);
+        hash = hash_update(hash, mcu->sample_buffer,
+                           mcu->sample_write_ptr * sizeof(mcu->sample_buffer[0]));
+        frames += mcu->sample_write_ptr / 2;
+        if (trace)
+            fprintf(trace, "blk %d cycles=%llu samples=%d\n", block,
+                    (unsigned long long)mcu->mcu.cycles, mcu->sample_write_ptr);
+    }
+    double t3 = now_sec();
+
+    uint64_t play_instructions = mcu->instruction_count - boot_instructions;
+    double play_sec = t3 - t2;
+    double emulated_sec = (double)frames / CORE_SAMPLE_RATE;
+
+    printf("{\n");
+    printf("  \"audio_hash\": \"%016llx\",\n", (unsigned long long)hash);
+    printf("  \"frames\": %llu,\n", (unsigned long long)frames);
+    printf("  \"instructions\": %llu,\n", (unsigned long long)play_instructions);
+    printf("  \"mcu_cycles\": %llu,\n", (unsigned long long)mcu->mcu.cycles);
+    printf("  \"emulated_sec\": %.3f,\n", emulated_sec);
+    printf("  \"instructions_per_sec\": %.0f,\n", play_instructions / play_sec);
+    printf("  \"samples_per_sec\": %.0f,\n", frames / play_sec);
+    printf("  \"realtime_factor\": %.3f,\n", emulated_sec / play_sec);
+    print_resampler_table();
+    printf("  \"phases_ms\": {\n");
+    printf("    \"load\": %.1f,\n", (t1 - t0) * 1000.0);
+    printf("    \"boot\": %.1f,\n", (t2 - t1) * 1000.0);
+    printf("    \"play\": %.1f\n", play_sec * 1000.0);
+    printf("  }\n");
+    printf("}\n");
+
+    delete mcu;
+    if (trace)
+        fclose(trace);
+    delete[] rom1;
+    delete[] rom2;
+    delete[] waverom1;
+    delete[] waverom2;
+    delete[] nvram;
+
+    return 0;
+}